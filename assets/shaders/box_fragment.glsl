@@ -50,10 +50,18 @@ in vec3 FragPos;
 #define N_POINT_LIGHTS 4
 
 uniform Material material;
-uniform DirLight dirLight;
-uniform PointLight pointLights[N_POINT_LIGHTS];
-uniform SpotLight spotLight;
-uniform vec3 viewPos;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLights[N_POINT_LIGHTS];
+    SpotLight spotLight;
+};
 
 vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
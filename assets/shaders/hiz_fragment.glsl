@@ -0,0 +1,36 @@
+#version 330 core
+out float Depth;
+
+// the level below, restricted to its own mip level so it can be read while the next one is written
+uniform sampler2D source;
+
+float fetch(ivec2 coords, ivec2 size)
+{
+    return texelFetch(source, min(coords, size - 1), 0).r;
+}
+
+void main()
+{
+    ivec2 size = textureSize(source, 0);
+    ivec2 coords = ivec2(gl_FragCoord.xy);
+    ivec2 base = coords * 2;
+
+    // furthest of the 2x2 texels below
+    float depth = max(max(fetch(base, size), fetch(base + ivec2(1, 0), size)),
+                      max(fetch(base + ivec2(0, 1), size), fetch(base + ivec2(1, 1), size)));
+
+    // odd sizes round down, so the last column and row also cover the texels left over
+    bool extra_column = (size.x & 1) == 1 && coords.x == size.x / 2 - 1;
+    bool extra_row = (size.y & 1) == 1 && coords.y == size.y / 2 - 1;
+    if (extra_column) {
+        depth = max(depth, max(fetch(base + ivec2(2, 0), size), fetch(base + ivec2(2, 1), size)));
+    }
+    if (extra_row) {
+        depth = max(depth, max(fetch(base + ivec2(0, 2), size), fetch(base + ivec2(1, 2), size)));
+    }
+    if (extra_column && extra_row) {
+        depth = max(depth, fetch(base + ivec2(2, 2), size));
+    }
+
+    Depth = depth;
+}
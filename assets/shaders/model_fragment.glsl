@@ -3,9 +3,27 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
+#if defined(INDIRECT)
+flat in uint MaterialIndex;
+
+struct MaterialData {
+    uint diffuseLayer;
+};
+
+layout (std430, binding = 2) readonly buffer Materials {
+    MaterialData materials[];
+};
+
+uniform sampler2DArray material_array; // holds the diffuse textures of every draw in the group
+#else
 uniform sampler2D texture_diffuse1;
+#endif
 
 void main()
 {    
+#if defined(INDIRECT)
+    FragColor = texture(material_array, vec3(TexCoords, materials[MaterialIndex].diffuseLayer));
+#else
     FragColor = texture(texture_diffuse1, TexCoords);
+#endif
 }
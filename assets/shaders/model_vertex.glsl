@@ -1,16 +1,57 @@
-#version 330 core
+#version 430 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
+#if defined(INDIRECT)
+layout (location = 7) in uint aDrawIndex; // equals the indirect command's baseInstance
+
+flat out uint MaterialIndex;
+
+struct DrawData {
+    uint transformIndex;
+    uint materialIndex;
+};
+
+layout (std430, binding = 0) readonly buffer Transforms {
+    mat4 transforms[];
+};
+
+layout (std430, binding = 1) readonly buffer Draws {
+    DrawData draws[];
+};
+#elif defined(INSTANCED)
+layout (location = 3) in mat4 aInstanceModel; // per-instance transform, occupies locations 3 to 6
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+#if defined(QUANTIZED_POSITIONS)
+uniform vec3 vertexBoundsMin; // positions arrive as unorm16 within the mesh bounds
+uniform vec3 vertexBoundsSize;
+#endif
 
 void main()
 {
+#if defined(INDIRECT)
+    mat4 model = transforms[draws[aDrawIndex].transformIndex];
+    MaterialIndex = draws[aDrawIndex].materialIndex;
+#elif defined(INSTANCED)
+    mat4 model = aInstanceModel;
+#endif
+#if defined(QUANTIZED_POSITIONS)
+    vec3 position = vertexBoundsMin + aPos * vertexBoundsSize;
+#else
+    vec3 position = aPos;
+#endif
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * model * vec4(position, 1.0);
 }
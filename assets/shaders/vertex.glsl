@@ -1,19 +1,75 @@
 #version 430 core
 layout (location = 0) in vec3 aPos;
+#if defined(PACKED_NORMALS)
+layout (location = 1) in vec2 aPackedNormal; // octahedral
+#else
 layout (location = 1) in vec3 aNormal;
+#endif
 layout (location = 2) in vec2 aTexCoord;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
+#if defined(INDIRECT)
+layout (location = 7) in uint aDrawIndex; // equals the indirect command's baseInstance
+
+struct DrawData {
+    uint transformIndex;
+    uint materialIndex;
+};
+
+layout (std430, binding = 0) readonly buffer Transforms {
+    mat4 transforms[];
+};
+
+layout (std430, binding = 1) readonly buffer Draws {
+    DrawData draws[];
+};
+#elif defined(INSTANCED)
+layout (location = 3) in mat4 aInstanceModel; // per-instance transform, occupies locations 3 to 6
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+#if defined(QUANTIZED_POSITIONS)
+uniform vec3 vertexBoundsMin; // positions arrive as unorm16 within the mesh bounds
+uniform vec3 vertexBoundsSize;
+#endif
+
+#if defined(PACKED_NORMALS)
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float fold = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -fold : fold, n.y >= 0.0 ? -fold : fold);
+    return normalize(n);
+}
+#endif
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+#if defined(INDIRECT)
+    mat4 model = transforms[draws[aDrawIndex].transformIndex];
+#elif defined(INSTANCED)
+    mat4 model = aInstanceModel;
+#endif
+#if defined(QUANTIZED_POSITIONS)
+    vec3 position = vertexBoundsMin + aPos * vertexBoundsSize;
+#else
+    vec3 position = aPos;
+#endif
+#if defined(PACKED_NORMALS)
+    vec3 normal = decodeOctahedral(aPackedNormal);
+#else
+    vec3 normal = aNormal;
+#endif
+    gl_Position = projection * view * model * vec4(position, 1.0);
     TexCoords = aTexCoord;
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * normal;
+    FragPos = vec3(model * vec4(position, 1.0));
 }
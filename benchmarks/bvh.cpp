@@ -0,0 +1,103 @@
+// Times building, updating and querying the BVH at 10k, 100k and 1M boxes, with the linear SIMD culler
+// as the baseline for queries. Boxes are spread so the density stays the same at every size.
+
+#include "bvh.h"
+#include "frustum.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static BoundingBox make_box(const glm::vec3& center, float half_size) {
+    return {center - glm::vec3(half_size), center + glm::vec3(half_size)};
+}
+
+int main() {
+    std::printf("%9s %10s %10s %10s %10s %10s %10s\n", "boxes", "insert ms", "update ms", "reinserts", "query ms",
+                "linear ms", "visible");
+
+    for (size_t count : {10000, 100000, 1000000}) {
+        std::mt19937 rng(1);
+        float extent = 10.0f * std::cbrt(static_cast<float>(count));
+        std::uniform_real_distribution<float> position(-extent, extent);
+        std::uniform_real_distribution<float> size(0.2f, 1.0f);
+        std::uniform_real_distribution<float> jitter(-0.05f, 0.05f);
+
+        std::vector<glm::vec3> centers(count);
+        std::vector<float> sizes(count);
+        for (size_t i = 0; i < count; i++) {
+            centers[i] = glm::vec3(position(rng), position(rng), position(rng));
+            sizes[i] = size(rng);
+        }
+
+        BVH bvh;
+        std::vector<int> proxies(count);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < count; i++) {
+            proxies[i] = bvh.insert(make_box(centers[i], sizes[i]), static_cast<uint32_t>(i));
+        }
+        double insert_time = elapsed_ms(start);
+
+        // most boxes drift inside their fat margin, every hundredth one jumps across the scene
+        size_t reinserts = 0;
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < count; i++) {
+            if (i % 100 == 0) {
+                centers[i] = glm::vec3(position(rng), position(rng), position(rng));
+            } else {
+                centers[i] += glm::vec3(jitter(rng), jitter(rng), jitter(rng));
+            }
+            reinserts += bvh.update(proxies[i], make_box(centers[i], sizes[i]));
+        }
+        double update_time = elapsed_ms(start);
+
+        // a camera at the edge of the boxes looking across them
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, extent);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, extent), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum(projection * view);
+
+        constexpr int queries = 10;
+        std::vector<uint32_t> results;
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < queries; i++) {
+            results.clear();
+            bvh.query_frustum(frustum, results);
+        }
+        double query_time = elapsed_ms(start) / queries;
+
+        FrustumCuller culler;
+        for (size_t i = 0; i < count; i++) {
+            culler.add(make_box(centers[i], sizes[i]));
+        }
+        std::vector<uint8_t> visibility;
+        size_t visible = 0;
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < queries; i++) {
+            visible = culler.cull(frustum, visibility);
+        }
+        double linear_time = elapsed_ms(start) / queries;
+
+        // the tree tests fattened boxes, so it may return a few extra but never miss one
+        std::vector<uint8_t> found(count, 0);
+        for (uint32_t index : results) {
+            found[index] = 1;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (visibility[i] && !found[i]) {
+                std::fprintf(stderr, "box %zu is visible but missing from the BVH query\n", i);
+                return EXIT_FAILURE;
+            }
+        }
+
+        std::printf("%9zu %10.2f %10.2f %10zu %10.3f %10.3f %10zu\n", count, insert_time, update_time, reinserts,
+                    query_time, linear_time, visible);
+    }
+    return EXIT_SUCCESS;
+}
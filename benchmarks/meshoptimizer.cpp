@@ -0,0 +1,73 @@
+// Times each MeshOptimizer pass on spheres of 10k, 100k and 1M triangles in random order, and prints the
+// simulated vertex cache misses per triangle (ACMR) and per vertex (ATVR) after every pass.
+
+#include "meshoptimizer.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// latitude-longitude sphere with shuffled triangles, segments^2 * 2 triangles
+static MeshData make_shuffled_sphere(uint32_t segments) {
+    MeshData mesh;
+    for (uint32_t y = 0; y <= segments; y++) {
+        for (uint32_t x = 0; x <= segments; x++) {
+            float theta = glm::pi<float>() * y / segments;
+            float phi = glm::two_pi<float>() * x / segments;
+            glm::vec3 position(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            mesh.vertices.push_back({position, position, glm::vec2(float(x) / segments, float(y) / segments)});
+        }
+    }
+
+    std::vector<std::array<GLuint, 3>> triangles;
+    for (uint32_t y = 0; y < segments; y++) {
+        for (uint32_t x = 0; x < segments; x++) {
+            GLuint a = y * (segments + 1) + x, b = a + 1, c = a + segments + 1, d = c + 1;
+            triangles.push_back({a, c, b});
+            triangles.push_back({b, c, d});
+        }
+    }
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(1));
+    for (const auto& triangle : triangles) {
+        mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+    }
+    return mesh;
+}
+
+int main() {
+    std::printf("%9s %-9s %10s %8s %8s\n", "triangles", "pass", "ms", "acmr", "atvr");
+
+    for (uint32_t segments : {71, 224, 708}) {
+        MeshData mesh = make_shuffled_sphere(segments);
+        size_t triangle_count = mesh.indices.size() / 3;
+
+        auto print = [&](const char* pass, double time) {
+            VertexCacheStats stats = MeshOptimizer::analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+            std::printf("%9zu %-9s %10.2f %8.3f %8.3f\n", triangle_count, pass, time, stats.acmr, stats.atvr);
+        };
+        print("shuffled", 0.0);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        MeshOptimizer::optimize_vertex_cache(mesh.indices, mesh.vertices.size());
+        print("cache", elapsed_ms(start));
+
+        start = std::chrono::high_resolution_clock::now();
+        MeshOptimizer::optimize_overdraw(mesh.indices, mesh.vertices);
+        print("overdraw", elapsed_ms(start));
+
+        start = std::chrono::high_resolution_clock::now();
+        MeshOptimizer::optimize_vertex_fetch(mesh.vertices, mesh.indices);
+        print("fetch", elapsed_ms(start));
+    }
+    return EXIT_SUCCESS;
+}
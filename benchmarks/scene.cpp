@@ -0,0 +1,76 @@
+// Times Scene::update_world_matrices on a 500k entity hierarchy with 1 thread and with every thread OpenMP
+// offers, for a full update, a tenth of the entities moving, and a few moving (the serial subtree path).
+
+#include "scene.h"
+
+#include <omp.h>
+
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+
+constexpr uint32_t entity_count = 500000;
+constexpr uint32_t group_size = 100; // entities per root, each parented to a random earlier one of its group
+
+static double time_update(Scene& scene, const std::vector<EntityHandle>& moved, int repeats) {
+    double total = 0.0;
+    for (int r = 0; r < repeats; r++) {
+        for (EntityHandle handle : moved) {
+            scene.set_position(handle, scene.get_position(handle) + glm::vec3(0.001f));
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        scene.update_world_matrices();
+        total += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    return total / repeats;
+}
+
+int main() {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+
+    Scene scene;
+    std::vector<EntityHandle> handles;
+    handles.reserve(entity_count);
+    for (uint32_t i = 0; i < entity_count; i++) {
+        uint32_t group_index = i % group_size;
+        EntityHandle parent = group_index == 0 ? EntityHandle{} : handles[i - 1 - rng() % group_index];
+        EntityHandle handle = scene.create(0, 0, 0, parent);
+        scene.set_position(handle, glm::vec3(offset(rng), offset(rng), offset(rng)));
+        handles.push_back(handle);
+    }
+    scene.update_world_matrices();
+
+    std::vector<EntityHandle> roots, tenth, few;
+    for (uint32_t i = 0; i < entity_count; i++) {
+        if (i % group_size == 0) {
+            roots.push_back(handles[i]);
+        }
+        if (rng() % 10 == 0) {
+            tenth.push_back(handles[i]);
+        }
+    }
+    for (int i = 0; i < 100; i++) {
+        few.push_back(handles[rng() % entity_count]);
+    }
+
+    int max_threads = omp_get_max_threads();
+    std::printf("%u entities, %zu roots, up to %d threads\n", entity_count, roots.size(), max_threads);
+    std::printf("%8s %12s %12s %12s\n", "threads", "all ms", "tenth ms", "100 ms");
+
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    for (int threads : thread_counts) {
+        omp_set_num_threads(threads);
+        double all = time_update(scene, roots, 10);
+        double some = time_update(scene, tenth, 10);
+        double single = time_update(scene, few, 10);
+        std::printf("%8d %12.3f %12.3f %12.3f\n", threads, all, some, single);
+    }
+    return EXIT_SUCCESS;
+}
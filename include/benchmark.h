@@ -0,0 +1,39 @@
+#pragma once
+
+#include "window.h"
+#include "renderer.h"
+
+#include <string>
+#include <vector>
+
+struct BenchmarkOptions {
+    int warmup_frames = 60; // rendered but not measured, more are added until textures finish streaming
+    int frames = 600;
+    std::string image_path;   // the last frame as a PPM, skipped if empty
+    std::string timings_path; // every measured frame as CSV, skipped if empty
+};
+
+// Renders a fixed number of frames along a scripted camera path and reports their timings, for performance
+// regression runs on render nodes and CI machines without a display. The camera circles the scene once over
+// the measured frames, so runs with the same frame count see the same views. Every frame is finished with
+// glFinish before the next one starts, frame times include the GPU and are not overlapped with the CPU.
+class Benchmark {
+public:
+    static void run(Window& window, Renderer& renderer, const BenchmarkOptions& options);
+
+private:
+    struct FrameTiming {
+        float update_time; // ms, CPU
+        float render_time; // ms, CPU, submitting the frame
+        float frame_time;  // ms, update to glFinish returning
+        int draw_calls;
+        FrameStats stats;
+    };
+
+    // renders one frame with the camera at angle and waits for it to finish
+    static FrameTiming render_frame(Window& window, Renderer& renderer, float angle);
+    // point the camera at the scene from angle radians around it
+    static void set_camera(WindowState& state, float angle);
+    static void print_summary(const char* name, std::vector<float> times);
+    static bool write_timings(const std::string& path, const std::vector<FrameTiming>& timings);
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <limits>
+#include <cmath>
+
+struct BoundingBox {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    void expand(const glm::vec3& point) {
+        this->min = glm::min(this->min, point);
+        this->max = glm::max(this->max, point);
+    }
+    void expand(const BoundingBox& box) {
+        this->min = glm::min(this->min, box.min);
+        this->max = glm::max(this->max, box.max);
+    }
+
+    bool is_empty() const { return this->min.x > this->max.x; }
+    bool contains(const BoundingBox& box) const {
+        return this->min.x <= box.min.x && this->min.y <= box.min.y && this->min.z <= box.min.z
+            && box.max.x <= this->max.x && box.max.y <= this->max.y && box.max.z <= this->max.z;
+    }
+    glm::vec3 center() const { return (this->min + this->max) * 0.5f; }
+    glm::vec3 extents() const { return (this->max - this->min) * 0.5f; }
+
+    // tight box around this box after an affine transform (Arvo's method)
+    BoundingBox transform(const glm::mat4& matrix) const {
+        glm::vec3 center = glm::vec3(matrix * glm::vec4(this->center(), 1.0f));
+        glm::vec3 extents = this->extents();
+        glm::vec3 world_extents;
+
+        for (int i = 0; i < 3; i++) {
+            world_extents[i] = std::fabs(matrix[0][i]) * extents.x
+                             + std::fabs(matrix[1][i]) * extents.y
+                             + std::fabs(matrix[2][i]) * extents.z;
+        }
+        return {center - world_extents, center + world_extents};
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "bounds.h"
+#include "frustum.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+// Dynamic bounding volume hierarchy over world-space boxes. Leaves store a fattened copy of their box,
+// so small movements only need a refit when the tight box escapes the fat one, and the tree is kept
+// balanced with rotations on insertion and removal.
+class BVH {
+public:
+    static constexpr int null_node = -1;
+
+    // returns a proxy id used to update or remove the box later, user_data is returned by queries
+    int insert(const BoundingBox& box, uint32_t user_data);
+    void remove(int proxy);
+    // returns true if the leaf had to be reinserted
+    bool update(int proxy, const BoundingBox& box);
+    void clear();
+
+    // appends the user data of every leaf whose box intersects the frustum
+    void query_frustum(const Frustum& frustum, std::vector<uint32_t>& results) const;
+
+    // finds the nearest leaf hit by the ray for which accept(user_data) is true
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, uint32_t& hit, float& distance,
+                 const std::function<bool(uint32_t)>& accept = nullptr) const;
+
+    uint32_t get_user_data(int proxy) const { return this->nodes[proxy].user_data; }
+    int get_height() const { return this->root == null_node ? 0 : this->nodes[this->root].height; }
+    size_t get_leaf_count() const { return this->leaf_count; }
+
+    float fat_margin = 0.1f; // world units added on each side of a leaf's box
+
+private:
+    struct Node {
+        BoundingBox box;    // fattened for leaves
+        BoundingBox tight;  // exact box, only set for leaves
+        int parent = null_node; // doubles as the next free node while on the free list
+        int left = null_node;
+        int right = null_node;
+        int height = 0;     // 0 for leaves, -1 for free nodes
+        uint32_t user_data = 0;
+
+        bool is_leaf() const { return this->left == null_node; }
+    };
+
+    int allocate_node();
+    void free_node(int node);
+    void insert_leaf(int leaf);
+    void remove_leaf(int leaf);
+    int balance(int node);
+    void refit_ancestors(int node);
+
+    std::vector<Node> nodes;
+    int root = null_node;
+    int free_list = null_node;
+    size_t leaf_count = 0;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// Block-compressed texture with a precomputed mip chain, written by the texture-cooker tool next to its
+// source image and preferred over the source by TextureCache.
+//
+// File layout: header | level records | compressed level data, largest level first
+
+enum class CookedFormat : uint32_t {
+    BC1 = 1, // RGB, 8 bytes per 4x4 block
+    BC3 = 3, // RGBA, BC1 color plus a BC4 alpha block, 16 bytes per block
+    BC4 = 4, // single channel, 8 bytes per block
+    BC5 = 5, // grey and alpha as two BC4 blocks, sampled as red and green, 16 bytes per block
+};
+
+struct CookedTextureHeader {
+    char magic[4];
+    uint32_t version;
+    CookedFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+    uint32_t channels; // of the source image
+    uint32_t flipped;  // rows were flipped vertically when cooking
+};
+
+struct CookedTextureLevel {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+class CookedTexture {
+public:
+    static constexpr char magic[4] = {'C', 'T', 'E', 'X'};
+    static constexpr uint32_t version = 2; // 2: BC5 stores alpha in its second block instead of grey
+
+    static std::string get_cooked_path(const std::string& source_path) { return source_path + ".ctex"; }
+
+    static uint32_t get_block_bytes(CookedFormat format) {
+        return format == CookedFormat::BC1 || format == CookedFormat::BC4 ? 8 : 16;
+    }
+
+    static uint64_t get_level_size(CookedFormat format, uint32_t width, uint32_t height) {
+        return uint64_t((width + 3) / 4) * ((height + 3) / 4) * CookedTexture::get_block_bytes(format);
+    }
+};
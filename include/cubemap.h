@@ -11,11 +11,12 @@
 class CubeMap {
 public:
     CubeMap() = default;
-    CubeMap(const std::vector<std::string>& faces, int texture_unit = 0);
+    CubeMap(const std::vector<std::string>& faces);
 
-    void draw(const glm::mat4& view, const glm::mat4& projection) const;
+    void draw() const; // view and projection come from the Camera uniform block
 
     VertexArray VAO;
     Texture texture;
     Shader shader;
+    UniformHandle skybox_uniform = -1;
 };
@@ -3,6 +3,7 @@
 #include <glad/glad.h>
 
 #include <vector>
+#include <cstddef>
 
 class ElementBuffer {
 public:
@@ -19,5 +20,11 @@ public:
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, buffer.size() * sizeof(GLuint), buffer.data(), usage);
     }
 
+    // copies count elements starting at data, e.g. straight from a memory-mapped file
+    template <typename T>
+    void write_buffer_data(const T* data, size_t count, GLenum usage) {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(T), data, usage);
+    }
+
     GLuint id;
 };
@@ -5,6 +5,8 @@
 #include "texture.h"
 #include "shader.h"
 
+#include <string>
+
 class Framebuffer {
 public:
     Framebuffer() = default;
@@ -13,12 +15,15 @@ public:
     void bind() { glBindFramebuffer(GL_FRAMEBUFFER, this->id); }
     void unbind() { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
     void draw_to_screen();
+    // writes the color buffer as a binary PPM, false if the file could not be written
+    bool save_ppm(const std::string& path);
 
     GLuint id;
-    GLuint renderbuffer;
+    GLuint depth_texture; // depth in the red channel when sampled
     GLuint quad_vertexarray;
     int width, height;
 
     Texture colorbuffer;
     Shader screen_shader;
+    UniformHandle screen_texture_uniform = -1;
 };
\ No newline at end of file
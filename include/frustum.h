@@ -0,0 +1,39 @@
+#pragma once
+
+#include "bounds.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+struct Frustum {
+    Frustum() = default;
+    Frustum(const glm::mat4& view_projection);
+
+    // conservative, spheres just outside a corner of the frustum count as intersecting
+    bool intersects(const BoundingSphere& sphere) const;
+
+    // normalized planes (normal, distance) facing inwards: left, right, bottom, top, near, far
+    glm::vec4 planes[6];
+};
+
+// Holds world-space boxes as structure-of-arrays (centers and extents) so they can be tested against
+// the frustum 8 (AVX) or 4 (SSE) at a time.
+class FrustumCuller {
+public:
+    void clear();
+    void add(const BoundingBox& box);
+
+    // writes 1 for every box intersecting the frustum and 0 otherwise, returns the number visible
+    size_t cull(const Frustum& frustum, std::vector<uint8_t>& visibility) const;
+
+    size_t size() const { return this->count; }
+
+private:
+    size_t count = 0;
+
+    // padded to a multiple of 8 so the SIMD loop needs no remainder handling
+    std::vector<float> center_x, center_y, center_z;
+    std::vector<float> extent_x, extent_y, extent_z;
+};
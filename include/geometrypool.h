@@ -0,0 +1,63 @@
+#pragma once
+
+#include "mesh.h"
+#include "vertexarray.h"
+#include "vertexbuffer.h"
+#include "elementbuffer.h"
+
+#include <vector>
+
+// index of the current draw, read by the INDIRECT shader variant to look up its DrawData. It is an
+// instanced attribute over an identity buffer, so each command's baseInstance selects its own entry.
+constexpr GLuint draw_index_attribute = 7;
+constexpr GLuint draw_index_binding = 7;
+
+// location of a mesh inside the pool's shared buffers
+struct MeshRange {
+    GLuint first_index;
+    GLuint index_count;
+    GLint base_vertex;
+};
+
+// layout consumed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+// per-draw data in the DrawData storage block (std430)
+struct DrawData {
+    GLuint transform_index;
+    GLuint material_index;
+};
+
+// Suballocates static meshes from one shared vertex/index buffer pair so any number of them can be
+// submitted with a single glMultiDrawElementsIndirect, without rebinding vertex arrays in between.
+class GeometryPool {
+public:
+    // all meshes must be added before upload()
+    MeshRange add_mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+    // positions stay float whatever the format asks for, draws share no per-mesh bounds to dequantize with
+    void upload(const VertexFormat& format = {});
+
+    const VertexFormat& get_vertex_format() const { return this->vertex_format; } // as uploaded
+
+    // copies the frame's commands into the indirect buffer, command i must use base_instance i
+    void write_commands(const std::vector<DrawElementsIndirectCommand>& commands);
+    void draw(size_t first_command, GLsizei command_count) const;
+
+private:
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    VertexFormat vertex_format;
+
+    VertexArray VAO;
+    VertexBuffer VBO;
+    ElementBuffer EBO;
+    VertexBuffer draw_index_buffer;
+    GLuint indirect_buffer = 0;
+    size_t draw_index_capacity = 0;
+};
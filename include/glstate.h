@@ -0,0 +1,117 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// Shadows the currently bound program, vertex array and textures so redundant binds can be skipped.
+// Code that changes these bindings behind the cache's back (ImGui, resource creation) is accounted for
+// by calling invalidate() at the start of every frame.
+//
+// Textures are not tied to units. Sampling binds go through bind_texture, which hands out units from a
+// fixed pool and keeps textures resident across frames, evicting the least recently used one when the
+// pool is full. Creation and uploads bind on the scratch unit, the only unit ImGui touches, so the pool
+// units never change behind the cache's back and survive invalidate().
+class GLState {
+public:
+    static void use_program(GLuint program) {
+        if (program == GLState::program) {
+            GLState::redundant_changes++;
+            return;
+        }
+        glUseProgram(program);
+        GLState::program = program;
+        GLState::state_changes++;
+    }
+
+    static void bind_vertex_array(GLuint vertex_array) {
+        if (vertex_array == GLState::vertex_array) {
+            GLState::redundant_changes++;
+            return;
+        }
+        glBindVertexArray(vertex_array);
+        GLState::vertex_array = vertex_array;
+        GLState::state_changes++;
+    }
+
+    // binds texture to a pool unit and returns that unit for the sampler uniform
+    static GLuint bind_texture(GLenum target, GLuint texture) {
+        GLState::use_counter++;
+
+        GLuint slot = 0;
+        for (GLuint i = 0; i < pool_size; i++) {
+            if (GLState::slots[i].texture == texture && GLState::slots[i].target == target) {
+                GLState::slots[i].last_used = GLState::use_counter;
+                GLState::redundant_changes++;
+                return first_pool_unit + i;
+            }
+            if (GLState::slots[i].last_used < GLState::slots[slot].last_used) {
+                slot = i;
+            }
+        }
+
+        GLuint unit = first_pool_unit + slot;
+        if (unit != GLState::active_unit) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            GLState::active_unit = unit;
+        }
+        glBindTexture(target, texture);
+        GLState::slots[slot] = {target, texture, GLState::use_counter};
+        GLState::state_changes++;
+        return unit;
+    }
+
+    // binds on the scratch unit to create or upload to a texture, not for sampling
+    static void bind_for_upload(GLenum target, GLuint texture) {
+        if (GLState::active_unit != scratch_unit) {
+            glActiveTexture(GL_TEXTURE0 + scratch_unit);
+            GLState::active_unit = scratch_unit;
+        }
+        glBindTexture(target, texture);
+    }
+
+    // deleted names get reused, so a unit still recorded as holding one must not count as resident
+    static void forget_texture(GLuint texture) {
+        for (Slot& slot : GLState::slots) {
+            if (slot.texture == texture) {
+                slot = Slot{};
+            }
+        }
+    }
+
+    // forget the cached program, vertex array and active unit so their next bind always reaches the driver
+    static void invalidate() {
+        GLState::program = invalid;
+        GLState::vertex_array = invalid;
+        GLState::active_unit = invalid;
+    }
+
+    static void reset_counters() {
+        GLState::state_changes = 0;
+        GLState::redundant_changes = 0;
+        GLState::draw_calls = 0;
+    }
+
+    static inline int state_changes = 0;        // binds issued to the driver since the last reset
+    static inline int redundant_changes = 0;    // binds skipped because the object was already bound
+    static inline int draw_calls = 0;           // draw commands issued since the last reset
+
+private:
+    static constexpr GLuint invalid = 0xFFFFFFFF;
+    static constexpr GLuint scratch_unit = 0;
+    static constexpr GLuint first_pool_unit = 1;
+    static constexpr GLuint pool_size = 32; // well below the 96 units GL 4.3 guarantees in total
+
+    // zeroed slots hold texture 0, which is also what GL leaves bound when a bound texture is deleted
+    struct Slot {
+        GLenum target;
+        GLuint texture;
+        uint64_t last_used;
+    };
+
+    static inline GLuint program = invalid;
+    static inline GLuint vertex_array = invalid;
+    static inline GLuint active_unit = invalid;
+    static inline Slot slots[pool_size];
+    static inline uint64_t use_counter = 0;
+};
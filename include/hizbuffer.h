@@ -0,0 +1,71 @@
+#pragma once
+
+#include "bounds.h"
+#include "shader.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// Hierarchical depth buffer for occlusion culling. Every texel of a level holds the furthest depth of the
+// texels it covers in the level below, so a box whose nearest point is further than the texels under it is
+// hidden. build() reduces the depth buffer on the GPU down to the first level at most readback_width wide and
+// reads that level back asynchronously, update() finishes the remaining levels on the CPU once it arrives.
+//
+// The depth is a frame or two old by the time boxes are tested, so they are projected with the
+// view-projection it was rendered with, and boxes reaching outside that view are never reported occluded.
+// That only covers the box itself: once the camera moves, parallax can uncover a box behind an occluder in
+// the old depth, and it would stay culled until a newer pyramid arrives. Check is_view_current before testing.
+class HiZBuffer {
+public:
+    static constexpr int readback_width = 256;
+    // largest difference of any matrix element for a view to count as the one the depth was rendered from
+    static constexpr float view_tolerance = 1e-4f;
+
+    HiZBuffer() = default;
+    ~HiZBuffer();
+    HiZBuffer(const HiZBuffer&) = delete;
+    HiZBuffer& operator=(const HiZBuffer&) = delete;
+
+    // sized for a depth buffer of width by height
+    void init(int width, int height);
+
+    // reduces depth_texture, rendered with view_projection in frame, and starts reading it back. Does nothing
+    // while the previous read back is still in flight. Leaves its own framebuffer bound and blending disabled.
+    void build(GLuint depth_texture, const glm::mat4& view_projection, uint64_t frame);
+    // picks up a finished read back, returns true if the pyramid changed
+    bool update();
+    // drops the pyramid and any read back in flight, for when building stops and the depth would go stale
+    void reset();
+
+    // false until the first pyramid since init or reset has arrived
+    bool is_ready() const { return !this->levels.empty(); }
+    // the frame passed to the build the pyramid came from
+    uint64_t get_frame() const { return this->frame; }
+    // false once the camera has moved or turned since the depth of the pyramid was rendered
+    bool is_view_current(const glm::mat4& view_projection) const;
+    bool is_occluded(const BoundingBox& box) const;
+
+private:
+    // texel of level that covers pixel of the full resolution depth buffer along axis
+    int get_texel(int pixel, size_t level, int axis) const;
+
+    std::vector<glm::ivec2> sizes; // of every level, level 0 is the depth buffer itself
+    size_t readback_level = 0;     // last level reduced on the GPU
+
+    GLuint texture = 0;      // levels 1 to readback_level, as mip levels 0 and up
+    GLuint framebuffer = 0;
+    GLuint vertex_array = 0; // empty, the full screen triangle comes from gl_VertexID
+    GLuint pixel_buffer = 0;
+    GLsync fence = nullptr;
+    Shader shader;
+    UniformHandle source_uniform = -1;
+
+    glm::mat4 pending_view_projection;
+    uint64_t pending_frame = 0;
+    glm::mat4 view_projection;              // the depth in levels was rendered with
+    uint64_t frame = 0;                     // and the frame it was rendered in
+    std::vector<std::vector<float>> levels; // CPU copies of readback_level and up
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "texture.h"
+#include "storagebuffer.h"
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// per-material data in the Materials storage block (std430), indexed by DrawData::material_index
+struct MaterialData {
+    GLuint diffuse_layer;
+};
+
+// Copies the diffuse texture of every material into 2D texture arrays, one array per size, mip count,
+// format and wrap mode. The INDIRECT model shader looks up its layer in the Materials storage block, so
+// indirect draws only bind a texture when the array changes instead of once per material.
+//
+// The arrays hold copies, so update() has to run once streamed textures finish. It only copies the textures
+// whose size or format changed, and arrays grow by doubling, so a texture finishing does not copy the rest.
+class MaterialTable {
+public:
+    MaterialTable() = default;
+    ~MaterialTable();
+    MaterialTable(const MaterialTable&) = delete;
+    MaterialTable& operator=(const MaterialTable&) = delete;
+
+    // materials holds the textures of each material, as collected by the renderer
+    void build(const std::vector<std::vector<Texture>>& materials);
+    // same materials as the last build, only their textures may have changed since
+    void update(const std::vector<std::vector<Texture>>& materials);
+
+    // array holding the material's diffuse texture, 0 if it has none
+    GLuint get_array(GLuint material_index) const { return this->material_arrays[material_index]; }
+    // returns the unit for the material_array sampler
+    GLuint bind_array(GLuint array) const { return GLState::bind_texture(GL_TEXTURE_2D_ARRAY, array); }
+
+    size_t get_array_count() const { return this->arrays.size(); }
+    size_t get_layer_count() const { return this->layer_count; }
+
+private:
+    // a source texture as GL sees it, placeholders of streamed textures are sampled from level 1
+    struct SourceTexture {
+        GLuint id;
+        GLint base_level;
+        GLsizei width, height, levels;
+        GLenum internal_format;
+        GLint wrap;
+    };
+
+    struct TextureArray {
+        GLuint id;
+        SourceTexture format; // what every layer shares
+        GLsizei capacity;     // layers allocated
+        std::vector<SourceTexture> layers; // id 0 for free layers
+    };
+
+    static SourceTexture describe(GLuint texture);
+    static bool is_compatible(const SourceTexture& a, const SourceTexture& b);
+    // reallocates array with room for at least its layers, keeping the ones copied so far
+    static void grow(TextureArray& array);
+
+    void release();
+
+    std::vector<TextureArray> arrays;
+    std::vector<GLuint> material_arrays;
+    std::vector<MaterialData> material_data;
+    size_t layer_count = 0;
+    StorageBuffer storage;
+};
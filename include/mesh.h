@@ -5,45 +5,92 @@
 #include "elementbuffer.h"
 #include "shader.h"
 #include "texture.h"
+#include "bounds.h"
+#include "vertexformat.h"
 
 #include <vector>
 #include <string>
 #include <cstddef>
+#include <algorithm>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-struct Vertex {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 tex_coords;
+// per-instance transforms are read from vertex attributes 3 to 6 (one mat4 column each),
+// sourced from whatever buffer is attached to this vertex buffer binding point
+constexpr GLuint instance_attribute = 3;
+constexpr GLuint instance_binding = 3;
+
+struct MeshView;
+
+// one level of detail, a range of the mesh's indices into the shared vertex buffer
+struct MeshLod {
+    uint32_t first_index;
+    uint32_t index_count;
+    float error; // object-space distance to the full detail surface, 0 for level 0
 };
 
 struct MeshData {
     std::vector<Vertex> vertices;
-    std::vector<GLuint> indices;
+    std::vector<GLuint> indices; // every level of detail, back to back
     std::vector<Texture> textures;
+    std::vector<MeshLod> lods;   // empty if the indices are a single level
 };
 
 class Mesh {
 public:
-    Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures);
-    Mesh(const MeshData& mesh_data);
+    Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures,
+         const VertexFormat& format = {}, std::vector<MeshLod> lods = {});
+    Mesh(const MeshData& mesh_data, const VertexFormat& format = {});
+    // uploads straight from a mapped mesh cache, no CPU copy of the vertices and indices is kept
+    // keep_cpu_data copies the view's vertices and indices into the CPU arrays, which geometry pooling and
+    // the software occlusion rasterizer read
+    Mesh(const MeshView& mesh_view, std::vector<Texture> textures, const VertexFormat& format = {},
+         bool keep_cpu_data = false);
     void draw(const Shader& shader) const;
+    // draws count instances whose transforms start at first_instance in instance_buffer
+    void draw_instanced(const Shader& shader, GLuint instance_buffer, GLuint first_instance, GLsizei count,
+                        uint32_t lod = 0) const;
+    void bind_textures(const Shader& shader) const;
+    // sets the bounds quantized positions are relative to, does nothing for float positions
+    void set_vertex_bounds(const Shader& shader) const;
 
     static MeshData generate_cube_mesh();
     static MeshData generate_plane_mesh();
 
+    // empty for meshes uploaded from a mesh cache without keep_cpu_data
     std::vector<Vertex> vertices;
     std::vector<GLuint> indices;
     std::vector<Texture> textures;
+    GLsizei index_count = 0;  // all levels of detail
+    std::vector<MeshLod> lods; // at least one, level 0 is the full detail mesh
+    VertexFormat vertex_format; // as uploaded, after resolve()
+
+    // object-space bounds, computed from the vertices at construction
+    BoundingBox bounds;
+    BoundingSphere bounding_sphere;
 
 private:
     void setup_mesh();
+    void upload_vertices(const Vertex* vertices, size_t count);
+    void setup_instance_attributes();
+    void compute_bounds();
+    void setup_sampler_names();
+    // uniforms of this mesh in one shader program, resolved the first time the mesh is drawn with it
+    struct ShaderUniforms {
+        GLuint program;
+        std::vector<UniformHandle> samplers; // one per texture
+        UniformHandle vertex_bounds_min, vertex_bounds_size;
+    };
+    const ShaderUniforms& get_uniforms(const Shader& shader) const;
 
     VertexArray VAO;
     VertexBuffer VBO;
     ElementBuffer EBO;
+
+    std::vector<std::string> sampler_names; // uniform name for each texture, e.g. texture_diffuse1
+    // a mesh is only ever drawn with a handful of shader programs
+    mutable std::vector<ShaderUniforms> shader_uniforms;
 };
 
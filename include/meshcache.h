@@ -0,0 +1,62 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file, unmapped on destruction. data is null if the file could not be
+// opened or mapped.
+class MappedFile {
+public:
+    MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool is_open() const { return this->data != nullptr; }
+
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+};
+
+// identifies the import a cache file was built from, any mismatch makes the cache stale
+struct MeshCacheKey {
+    std::string source_path;
+    int64_t source_mtime;
+    uint64_t source_size;
+    uint32_t import_flags;
+    uint32_t optimize_flags; // MeshOptimizer passes run after the import
+};
+
+// a mesh inside a mapped cache file, the vertex and index pointers point into the mapping
+struct MeshView {
+    const Vertex* vertices;
+    uint32_t vertex_count;
+    const GLuint* indices;
+    uint32_t index_count;
+    BoundingBox bounds;
+    BoundingSphere bounding_sphere;
+    std::vector<TextureRef> textures;
+    std::vector<MeshLod> lods; // index ranges of each level of detail
+};
+
+// Binary cache of a model's final vertex, index and material data, so repeat loads skip the Assimp import.
+//
+// File layout, every section 16-byte aligned:
+//   header | mesh records | texture records | lod records | string table | vertex and index data
+class MeshCache {
+public:
+    static constexpr uint32_t version = 2;
+
+    // cache files live in cache/, named after a hash of the source path
+    static std::string get_cache_path(const std::string& source_path);
+    // returns false if the source file does not exist
+    static bool make_key(const std::string& source_path, uint32_t import_flags, uint32_t optimize_flags,
+                         MeshCacheKey& key);
+
+    // returns false if the file is truncated, from another version or built from a different source
+    static bool read(const MappedFile& file, const MeshCacheKey& key, std::vector<MeshView>& meshes);
+    static void write(const std::string& cache_path, const MeshCacheKey& key, const std::vector<Mesh>& meshes);
+};
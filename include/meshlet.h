@@ -0,0 +1,41 @@
+#pragma once
+
+#include "vertexformat.h"
+#include "bounds.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// a small cluster of a mesh's triangles, contiguous in its index buffer so it can be drawn on its own
+struct Meshlet {
+    uint32_t first_index; // relative to the mesh's first index
+    uint32_t index_count;
+    BoundingSphere sphere; // object space
+    glm::vec3 cone_axis;   // average triangle normal
+    float cone_cutoff;     // sine of the normal cone's half angle, 1 if the meshlet can never face away
+};
+
+// Splits meshes into meshlets and culls them. Meshlets are grown greedily over shared vertices, preferring
+// triangles close to the meshlet's center so the bounding spheres and normal cones stay tight.
+class MeshletBuilder {
+public:
+    static constexpr uint32_t max_vertices = 64;
+    static constexpr uint32_t max_triangles = 124;
+
+    // reorders the triangles in indices so every meshlet's triangles are contiguous
+    static std::vector<Meshlet> build(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+    // true if every triangle of the meshlet faces away from the camera, given in the mesh's object space
+    static bool is_backfacing(const Meshlet& meshlet, const glm::vec3& camera_position) {
+        glm::vec3 to_center = meshlet.sphere.center - camera_position;
+        return glm::dot(to_center, meshlet.cone_axis)
+            >= meshlet.cone_cutoff * glm::length(to_center) + meshlet.sphere.radius;
+    }
+
+private:
+    static Meshlet compute_bounds(const std::vector<Vertex>& vertices, const GLuint* indices, uint32_t first_index,
+                                  uint32_t index_count);
+};
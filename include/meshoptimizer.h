@@ -0,0 +1,43 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstdint>
+
+// post-transform cache efficiency of an index buffer, simulated with a FIFO cache
+struct VertexCacheStats {
+    float acmr; // average cache misses per triangle, 0.5 is the ideal for large regular meshes
+    float atvr; // average transformed vertices per referenced vertex, 1 is the ideal
+};
+
+// CPU passes that reorder imported meshes for the GPU without changing what is drawn. Run them in the
+// order of optimize(): level of detail generation first, then vertex cache, overdraw on top of the
+// cache-friendly order, and vertex fetch last since it only renumbers vertices.
+class MeshOptimizer {
+public:
+    enum Flags : uint32_t {
+        VertexCache = 1 << 0,
+        Overdraw = 1 << 1,
+        VertexFetch = 1 << 2,
+        GenerateLods = 1 << 3, // appends simplified levels to the indices, see MeshSimplifier
+        All = VertexCache | Overdraw | VertexFetch | GenerateLods,
+    };
+
+    static void optimize(MeshData& mesh, uint32_t flags);
+
+    // Forsyth's linear-speed vertex cache optimization, reorders triangles only
+    static void optimize_vertex_cache(std::vector<GLuint>& indices, size_t vertex_count);
+    // splits the triangle order into clusters at points where the cache is cold anyway, then sorts the
+    // clusters so outward facing ones come first. Clusters are split further as long as each keeps an ACMR
+    // within threshold times that of the cluster it came from.
+    static void optimize_overdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices,
+                                  float threshold = 1.05f);
+    // renumbers vertices in order of first use and drops unreferenced ones
+    static void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+    static VertexCacheStats analyze_vertex_cache(const std::vector<GLuint>& indices, size_t vertex_count,
+                                                 uint32_t cache_size = 16);
+};
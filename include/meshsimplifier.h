@@ -0,0 +1,28 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstdint>
+
+// Quadric error metric simplification (Garland and Heckbert). Edges collapse onto one of their existing
+// endpoints, so every level indexes the original vertex buffer and a LOD is nothing but another index range.
+//
+// Vertices on open borders, non-manifold edges and attribute seams (several vertices at one position) are
+// locked, which keeps silhouettes and texture mapping intact at the cost of less reduction on such meshes.
+class MeshSimplifier {
+public:
+    // collapses edges until at most target_index_count indices remain or every further collapse would
+    // exceed max_error. error receives the largest collapse error, an estimate of the distance between the
+    // result and the input surface.
+    static std::vector<GLuint> simplify(const std::vector<Vertex>& vertices, const GLuint* indices,
+                                        size_t index_count, size_t target_index_count, float max_error,
+                                        float& error);
+
+    // appends up to max_lods - 1 levels, each about half the triangles of the one before, to indices and
+    // returns the ranges of all levels. Level 0 is the input. Stops early once a level barely reduces.
+    static std::vector<MeshLod> build_lods(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices,
+                                           uint32_t max_lods = 5);
+};
@@ -5,6 +5,8 @@
 #include <chrono>
 
 #include "mesh.h"
+#include "meshcache.h"
+#include "meshoptimizer.h"
 #include "shader.h"
 
 #include <assimp/Importer.hpp>
@@ -17,20 +19,59 @@ struct MaterialType {
     std::string type_name;
 };
 
+// CPU-side result of converting one aiMesh, its textures are created later on the GL thread
+struct ImportedMesh {
+    MeshData data;
+    std::vector<TextureRef> texture_refs;
+};
+
 class Model {
 public:
     Model() = default;
-    Model(std::string path) { load_model(path); }
-    void add_mesh(Mesh mesh) { this->meshes.push_back(std::move(mesh)); };
+    // optimize_flags selects the MeshOptimizer passes run on freshly imported meshes, cached meshes already had
+    // them. All passes run by default, levels of detail included. Meshes loaded from the cache only keep their
+    // vertices and indices on the CPU with keep_cpu_data, which models added to the renderer's geometry pool need
+    Model(std::string path, const VertexFormat& vertex_format = {}, uint32_t optimize_flags = MeshOptimizer::All,
+          bool keep_cpu_data = false)
+        : vertex_format(vertex_format), optimize_flags(optimize_flags), keep_cpu_data(keep_cpu_data) {
+        load_model(path);
+    }
+
+    // assimp post-processing applied on import, part of the mesh cache key
+    static constexpr unsigned int import_flags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals;
+
+    void add_mesh(Mesh mesh) {
+        this->bounds.expand(mesh.bounds);
+        this->add_lod_errors(mesh);
+        this->meshes.push_back(std::move(mesh));
+    };
     void draw(const Shader& shader) const;
+    // meshes with fewer levels of detail than lod draw their coarsest
+    void draw_instanced(const Shader& shader, GLuint instance_buffer, GLuint first_instance, GLsizei count,
+                        uint32_t lod = 0) const;
+    GLuint get_material_id() const;
+    const std::vector<Mesh>& get_meshes() const { return this->meshes; }
+    const BoundingBox& get_bounds() const { return this->bounds; } // union of all mesh bounds
+    uint32_t get_lod_count() const { return this->lod_errors.size(); }
+    // the coarsest level whose error stays within max_error_pixels, error_scale converts object-space
+    // distances to pixels at the entity's distance
+    uint32_t select_lod(float error_scale, float max_error_pixels) const;
 
 private:
     void load_model(std::string path);
-    void process_node(aiNode* node, const aiScene* scene);
-    Mesh process_mesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> load_material_textures(const std::vector<MaterialType>& material_types);
+    bool load_cached_model(const MappedFile& file, const MeshCacheKey& key);
+    void process_node(const aiNode* node, const aiScene* scene, std::vector<const aiMesh*>& ai_meshes);
+    // safe to call from worker threads, reads the scene only
+    static ImportedMesh process_mesh(const aiMesh* mesh, const aiScene* scene);
+    void upload_meshes(std::vector<ImportedMesh>& imported_meshes);
+    void add_lod_errors(const Mesh& mesh);
+    std::vector<Texture> load_material_textures(const std::vector<TextureRef>& texture_refs);
 
     std::vector<Mesh> meshes;
-    std::vector<Texture> loaded_textures;
+    BoundingBox bounds;
+    std::vector<float> lod_errors = {0.0f}; // largest error of each level over all meshes
     std::string directory;
+    VertexFormat vertex_format; // requested for every loaded mesh
+    uint32_t optimize_flags = MeshOptimizer::All;
+    bool keep_cpu_data = false;
 };
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "mesh.h"
+#include "bounds.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// Depth-only software rasterizer for occlusion culling without a GPU. Occluders are transformed, clipped
+// against the near plane and binned into screen tiles, then the tiles are rasterized in parallel into a small
+// depth buffer, 8 pixels at a time with AVX2. Boxes are tested against the same buffer, so unlike HiZBuffer
+// the result is for the current view with no latency.
+//
+// A pixel counts as covered when its center is inside a triangle, which grows occluders by up to half a
+// pixel at their edges. Pick large, solid meshes as occluders and keep the buffer from getting too coarse.
+class OcclusionRasterizer {
+public:
+    static constexpr int tile_width = 32; // a multiple of the 8 pixel step
+    static constexpr int tile_height = 16;
+
+    OcclusionRasterizer(int width = 320, int height = 180);
+    void resize(int width, int height);
+
+    // drops the occluders of the last frame and clears the depth to the far plane
+    void begin(const glm::mat4& view_projection);
+    // occluders are drawn two-sided, so their winding does not matter
+    void add_occluder(const std::vector<Vertex>& vertices, const GLuint* indices, size_t index_count,
+                      const glm::mat4& world);
+    // the full detail level of mesh
+    void add_occluder(const MeshData& mesh, const glm::mat4& world);
+    void rasterize();
+
+    // false if the box, in world space, is behind the occluders at every pixel it covers
+    bool is_visible(const BoundingBox& box) const;
+
+    int get_width() const { return this->width; }
+    int get_height() const { return this->height; }
+    float get_depth(int x, int y) const { return this->depth[y * this->stride + x]; } // window depth, 0 to 1
+    size_t get_triangle_count() const { return this->triangles.size(); } // after clipping
+
+private:
+    // edge functions and depth plane of a screen-space triangle, all three edges are positive inside
+    struct Triangle {
+        float edge_a[3], edge_b[3], edge_c[3];
+        float z, z_dx, z_dy; // depth at the origin and its slopes
+        int min_x, min_y, max_x, max_y;
+    };
+
+    void add_triangle(const glm::vec4* clip);
+    void setup_triangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
+    void rasterize_tile(int tile);
+
+    int width = 0, height = 0;
+    int stride = 0; // width rounded up to the tile width
+    int tiles_x = 0, tiles_y = 0;
+    glm::mat4 view_projection;
+
+    std::vector<float> depth;
+    std::vector<glm::vec4> clip_vertices; // scratch for the occluder being added
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<uint32_t>> bins; // triangles overlapping each tile, in the order added
+};
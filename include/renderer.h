@@ -6,9 +6,23 @@
 #include "vertexbuffer.h"
 #include "elementbuffer.h"
 #include "shader.h"
+#include "uniformbuffer.h"
+#include "storagebuffer.h"
+#include "geometrypool.h"
+#include "meshlet.h"
+#include "frustum.h"
+#include "bvh.h"
+#include "scene.h"
 #include "texture.h"
+#include "texturecache.h"
+#include "texturestreamer.h"
+#include "materialtable.h"
 #include "framebuffer.h"
+#include "hizbuffer.h"
+#include "occlusionrasterizer.h"
 #include "cubemap.h"
+#include "renderqueue.h"
+#include "glstate.h"
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -19,16 +33,55 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <iostream>
-#include <map>
 
-struct Entity {
+using Transform = glm::mat4;
+
+constexpr float near_plane = 0.1f;
+constexpr float far_plane = 100.0f;
+
+// consecutive draws of the same shader and model, issued as one instanced draw per mesh
+struct DrawBatch {
+    uint32_t shader_id;
+    uint32_t model_id;
+    uint32_t lod;
+    bool is_highlighted;
+    GLuint first_instance;      // offset into the instance buffer
+    GLsizei instance_count;
+};
+
+// a texture every draw of a shader samples, independent of the mesh being drawn
+struct ShaderTexture {
+    std::string sampler;
+    Texture texture;
+    UniformHandle location = -1;          // of sampler in the shader, resolved once at init
+    UniformHandle indirect_location = -1; // and in its INDIRECT variant
+};
+
+// a mesh's location in the geometry pool together with the index of its texture set
+struct PooledMesh {
+    MeshRange range;
+    GLuint material_index;
+    std::vector<MeshLod> lods;     // relative to the range
+    std::vector<Meshlet> meshlets; // of level 0, empty for meshes small enough to always be drawn whole
+};
+
+// consecutive indirect commands sharing a shader, material texture array and stencil state
+struct IndirectGroup {
     size_t shader_id;
-    size_t model_id;
-    size_t transform_id;
-    bool is_highlighted = false;
+    GLuint texture_array;
+    bool is_highlighted;
+    size_t first_command;
+    GLsizei command_count;
 };
 
-using Transform = glm::mat4;
+// CPU timings and counts of the last updated frame
+struct FrameStats {
+    float scene_update_time; // ms
+    float cull_time;         // ms
+    float occlusion_time;    // ms, including drawing the software occluders
+    size_t visible_count;
+    size_t occluded_count;
+};
 
 class Renderer {
 public:
@@ -39,15 +92,93 @@ public:
     void render();
     void render_ui();
 
+    FrameStats get_frame_stats() const;
+    size_t get_streaming_count() const { return this->texture_streamer.get_pending_count(); }
+    // writes the last rendered frame, before it is drawn to the screen, as a binary PPM
+    bool save_image(const std::string& path) { return this->framebuffer.save_ppm(path); }
+
 private:
+    void update_scene();
+    void pick_entity(double x_pos, double y_pos);
+    void cull_entities();
+    void build_render_queue();
+    void build_batches();
+    void add_to_batch(std::vector<DrawBatch>& batches, uint32_t shader_id, uint32_t model_id, uint32_t lod,
+                      bool is_highlighted, const Transform& transform);
+    void draw_batches(const std::vector<DrawBatch>& batches);
+    void bind_shader_textures(uint32_t shader_id, bool indirect);
+    void build_indirect_commands();
+    void draw_indirect();
+
     Window* window;
     std::vector<Shader> shaders;
+    std::vector<Shader> indirect_shaders; // INDIRECT variants, indexed by shader id
+    UniformHandle shininess_uniform;
+    UniformHandle indirect_shininess_uniform;
     std::vector<Model> models;
-    std::vector<Transform> transforms;
+    VertexFormat vertex_format = VertexFormat::quantized(); // every mesh the renderer builds is packed with it
+    std::vector<std::vector<ShaderTexture>> shader_textures; // indexed by shader id
+    std::vector<UniformHandle> material_array_uniforms;      // in the INDIRECT variants, indexed by shader id
+    TextureStreamer texture_streamer;
+
+    Scene scene;
+    float scene_update_time = 0.0f; // ms
+    RenderQueue render_queue;
+    std::vector<uint8_t> entity_lods; // level of detail of each visible entity, indexed by entity slot
+    size_t reduced_lod_count = 0;     // visible entities drawn below full detail
+
+    // world-space bounds of every entity, keyed by entity slot
+    BVH bvh;
+    std::vector<int> bvh_proxies; // indexed by entity slot
+    std::vector<uint32_t> bvh_results;
+
+    FrustumCuller culler;
+    std::vector<uint8_t> visibility;
+    std::vector<uint32_t> cull_indices; // entity slot of each box added to the culler
+    size_t visible_count = 0;
+    size_t culled_count = 0;
+    float cull_time = 0.0f; // ms
+
+    // tested after the frustum, against the opaque depth of a previous frame, or against the entities tagged
+    // as occluders rasterized on the CPU for the current one
+    HiZBuffer hiz_buffer;
+    OcclusionRasterizer occlusion_rasterizer;
+    std::vector<uint64_t> moved_frames; // frame each entity last moved in, indexed by entity slot
+    uint64_t frame_count = 0;
+    size_t occluded_count = 0;
+    float occlusion_time = 0.0f; // ms, testing the entities
+    float hiz_build_time = 0.0f; // ms, reducing the depth and finishing the last read back
+    float occluder_raster_time = 0.0f; // ms, drawing the occluders in software
+    bool hiz_view_stale = false; // the camera moved since the pyramid's depth, so nothing was tested
+
+    // world matrices packed in draw order, each batch references a contiguous range
+    std::vector<Transform> instance_transforms;
+    VertexBuffer instance_buffer;
+    std::vector<DrawBatch> opaque_batches;
+    std::vector<DrawBatch> transparent_batches;
+    std::vector<DrawBatch> outline_batches;
+
+    // opaque entities submitted with glMultiDrawElementsIndirect when WindowState::use_indirect is set
+    GeometryPool geometry_pool;
+    std::vector<std::vector<PooledMesh>> pooled_meshes; // indexed by model id, then mesh
+    std::vector<std::vector<Texture>> materials;        // each distinct texture set, copied out of the meshes
+    MaterialTable material_table;
+    size_t material_table_textures = 0;                 // streamed textures finished when the table was updated
+    std::vector<DrawElementsIndirectCommand> indirect_commands;
+    std::vector<DrawData> draw_data;
+    std::vector<IndirectGroup> indirect_groups;
+    size_t meshlet_count = 0;       // meshlets of the visible entities, before culling
+    size_t backfacing_meshlets = 0;
+    size_t offscreen_meshlets = 0;
+    float meshlet_cull_time = 0.0f; // ms
+    StorageBuffer transform_storage;
+    StorageBuffer draw_data_storage;
 
-    std::vector<Entity> entities;
-    std::map<float, Entity> transparent_entities; // sorted map with key = distance
-    std::vector<Entity> stencil_entities;
+    // per-frame data uploaded once in update() and shared by every program through uniform blocks
+    CameraData camera;
+    LightsData lights;
+    UniformBuffer camera_buffer;
+    UniformBuffer lights_buffer;
 
     Framebuffer framebuffer;
     CubeMap skybox;
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+enum class RenderPass : uint32_t {
+    Opaque = 0,
+    Transparent = 1,
+    Outline = 2,
+};
+
+struct RenderCommand {
+    uint64_t key;
+    uint32_t index; // scene entity slot of the drawn entity
+};
+
+// Collects the draws of a frame and orders them by a 64-bit sort key so that draws sharing a shader,
+// texture set and model end up adjacent, which lets the GL state cache skip most rebinds.
+//
+// Key layout, most significant bits first:
+//   pass (4) | shader (10) | material (16) | model (14) | depth (20)
+// Transparent draws must be blended back to front, so their keys hold only the depth instead:
+//   pass (4) | unused (28) | inverted view distance (32)
+class RenderQueue {
+public:
+    void clear() { this->commands.clear(); }
+    void push(uint64_t key, uint32_t index) { this->commands.push_back({key, index}); }
+    void sort();
+
+    // depth is the normalized view distance in [0, 1]; nearer draws sort first to reduce overdraw
+    static uint64_t make_key(RenderPass pass, uint32_t shader_id, uint32_t material_id, uint32_t model_id,
+                             float depth);
+    // distance is the view distance in world units, further draws sort first
+    static uint64_t make_depth_key(RenderPass pass, float distance);
+    static RenderPass get_pass(uint64_t key) { return static_cast<RenderPass>(key >> 60); }
+
+    std::vector<RenderCommand> commands;
+
+private:
+    std::vector<RenderCommand> scratch; // reused between frames so sorting does not allocate
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+
+// Refers to an entity slot. The generation is bumped whenever a slot is destroyed, so handles to a
+// destroyed entity stop resolving even after the slot has been reused.
+struct EntityHandle {
+    static constexpr uint32_t null_index = UINT32_MAX;
+
+    uint32_t index = null_index;
+    uint32_t generation = 0;
+
+    bool is_null() const { return this->index == null_index; }
+};
+
+// pass membership, an entity is drawn in every pass whose tag it carries
+enum EntityTag : uint32_t {
+    OpaqueTag = 1 << 0,
+    TransparentTag = 1 << 1,
+    HighlightedTag = 1 << 2, // writes to the stencil buffer and gets an outline
+    OccluderTag = 1 << 3,    // drawn into the software occlusion buffer
+};
+
+// Entity store with one array per component (structure of arrays), indexed by entity slot. Local
+// transforms are kept as position, rotation and scale, and world matrices are only recomputed for
+// entities whose own or an ancestor's transform changed since the last update. Large updates walk the
+// hierarchy level by level, computing each level in parallel since siblings never depend on each other.
+class Scene {
+public:
+    EntityHandle create(uint32_t shader_id, uint32_t model_id, uint32_t tags, EntityHandle parent = {});
+    // destroys the entity and all of its children
+    void destroy(EntityHandle handle);
+
+    bool is_alive(EntityHandle handle) const;
+    bool is_alive(uint32_t index) const { return this->alive[index]; }
+    EntityHandle get_handle(uint32_t index) const { return {index, this->generations[index]}; }
+
+    void set_position(EntityHandle handle, const glm::vec3& position);
+    void set_rotation(EntityHandle handle, const glm::quat& rotation);
+    void set_scale(EntityHandle handle, const glm::vec3& scale);
+    const glm::vec3& get_position(EntityHandle handle) const { return this->positions[this->check(handle)]; }
+    const glm::quat& get_rotation(EntityHandle handle) const { return this->rotations[this->check(handle)]; }
+    const glm::vec3& get_scale(EntityHandle handle) const { return this->scales[this->check(handle)]; }
+
+    // recomputes the world matrices of dirty entities and their descendants, returns the slots that
+    // changed (including destroyed ones) so systems caching world-space data can update them
+    const std::vector<uint32_t>& update_world_matrices();
+    const std::vector<glm::mat4>& get_world_matrices() const { return this->world_matrices; }
+
+    // number of slots, including destroyed ones which have no tags
+    size_t size() const { return this->alive.size(); }
+    size_t get_entity_count() const { return this->alive.size() - this->free_slots.size(); }
+
+    // per-entity render data, systems iterating the scene read and write these directly
+    std::vector<uint32_t> shader_ids;
+    std::vector<uint32_t> model_ids;
+    std::vector<uint32_t> tags;
+    std::vector<uint8_t> visible; // result of this frame's frustum test
+
+private:
+    // below this many dirty entities, walking the dirty subtrees beats touching every entity
+    static constexpr size_t parallel_threshold = 1024;
+
+    uint32_t check(EntityHandle handle) const;
+    void mark_dirty(uint32_t index);
+    void compute_world_matrix(uint32_t index);
+    void update_subtree(uint32_t index);
+    void update_levels();
+    void update_parallel();
+
+    // local transform components
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> world_matrices;
+
+    // hierarchy as intrusive child lists
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> first_children;
+    std::vector<uint32_t> next_siblings;
+    std::vector<uint32_t> depths;
+    std::vector<std::vector<uint32_t>> levels; // live entity slots grouped by depth
+    bool levels_dirty = false;
+
+    std::vector<uint32_t> generations;
+    std::vector<uint8_t> alive;
+    std::vector<uint8_t> dirty;
+    std::vector<uint8_t> world_changed; // written by update_parallel so children see their parent changed
+    std::vector<uint32_t> dirty_slots;
+    std::vector<uint32_t> changed_slots;
+    std::vector<uint32_t> free_slots;
+    std::vector<uint32_t> stack; // reused by update_subtree
+};
@@ -4,45 +4,66 @@
 #include "glm/gtc/type_ptr.hpp"
 #include <glad/glad.h>
 
+#include "uniformbuffer.h"
+#include "glstate.h"
+
 #include <cstdio>
 #include <string>
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <vector>
+#include <unordered_map>
+
+// uniform location resolved once at link time, pass to Shader::set to skip the name lookup
+using UniformHandle = GLint;
 
 class Shader {
 public:
     Shader() = default;
-    Shader(std::string vertex_path, std::string fragment_path);
+    // each define is inserted as "#define <define>" after the #version line of both stages
+    Shader(std::string vertex_path, std::string fragment_path, const std::vector<std::string>& defines = {});
     
-    void use() const { glUseProgram(this->id); };
+    void use() const { GLState::use_program(this->id); };
+
+    // returns -1 (ignored by glUniform*) if the uniform is not active in this program
+    UniformHandle get_uniform(const std::string& name) const {
+        auto it = this->uniforms.find(name);
+        return it != this->uniforms.end() ? it->second : -1;
+    };
 
-    void set(const std::string& name, bool value) const {
-        glUniform1i(glGetUniformLocation(this->id, name.c_str()), (int)value);
+    void set(UniformHandle location, bool value) const {
+        glUniform1i(location, (int)value);
     };
-    void set(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(this->id, name.c_str()), value);
+    void set(UniformHandle location, int value) const {
+        glUniform1i(location, value);
     };
-    void set(const std::string& name, float value) const {
-        glUniform1f(glGetUniformLocation(this->id, name.c_str()), value);
+    void set(UniformHandle location, float value) const {
+        glUniform1f(location, value);
     };
-    void set(const std::string& name, const glm::vec2& value) const {
-        glUniform2fv(glGetUniformLocation(this->id, name.c_str()), 1, glm::value_ptr(value));
+    void set(UniformHandle location, const glm::vec2& value) const {
+        glUniform2fv(location, 1, glm::value_ptr(value));
     };
-    void set(const std::string& name, const glm::vec3& value) const {
-        glUniform3fv(glGetUniformLocation(this->id, name.c_str()), 1, glm::value_ptr(value));
+    void set(UniformHandle location, const glm::vec3& value) const {
+        glUniform3fv(location, 1, glm::value_ptr(value));
     };
-    void set(const std::string& name, const glm::vec4& value) const {
-        glUniform4fv(glGetUniformLocation(this->id, name.c_str()), 1, glm::value_ptr(value));
+    void set(UniformHandle location, const glm::vec4& value) const {
+        glUniform4fv(location, 1, glm::value_ptr(value));
     };
-    void set(const std::string& name, const glm::mat2& value) const {
-        glUniformMatrix2fv(glGetUniformLocation(this->id, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    void set(UniformHandle location, const glm::mat2& value) const {
+        glUniformMatrix2fv(location, 1, GL_FALSE, glm::value_ptr(value));
     };
-    void set(const std::string& name, const glm::mat3& value) const {
-        glUniformMatrix3fv(glGetUniformLocation(this->id, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    void set(UniformHandle location, const glm::mat3& value) const {
+        glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
     };
-    void set(const std::string& name, const glm::mat4& value) const {
-        glUniformMatrix4fv(glGetUniformLocation(this->id, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    void set(UniformHandle location, const glm::mat4& value) const {
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+    };
+
+    // name-based setters look up the table built at link time instead of querying the driver
+    template <typename T>
+    void set(const std::string& name, const T& value) const {
+        this->set(this->get_uniform(name), value);
     };
 
     GLuint id;
@@ -53,6 +74,11 @@ public:
     };
 
 private:
+    static std::string add_defines(const std::string& source, const std::vector<std::string>& defines);
     GLuint compile(const std::string& source, Shader::Type type);
     void link(GLuint vertex, GLuint fragment);
+    void reflect_uniforms();
+    void bind_uniform_blocks();
+
+    std::unordered_map<std::string, UniformHandle> uniforms;
 };
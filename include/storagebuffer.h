@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// binding points of the shader storage blocks, must match the binding qualifiers in assets/shaders/*.glsl
+enum StorageBlock : GLuint {
+    TransformsStorage = 0,
+    DrawDataStorage = 1,
+    MaterialsStorage = 2,
+};
+
+class StorageBuffer {
+public:
+    StorageBuffer() { glGenBuffers(1, &this->id); }
+    // create destructor after implementing renderer class
+
+    void bind() { glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->id); }
+    void unbind() { glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0); }
+
+    // attaches the whole buffer to a storage block binding point
+    void bind_base(StorageBlock binding) { glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, this->id); }
+
+    // copies user-defined data into currently bound buffer
+    template <typename T>
+    void write_buffer_data(const std::vector<T>& buffer, GLenum usage) {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, buffer.size() * sizeof(T), buffer.data(), usage);
+    }
+
+    GLuint id;
+};
@@ -2,11 +2,12 @@
 
 #include <glad/glad.h>
 
+#include "glstate.h"
+
 #include <string>
 #include <iostream>
 #include <vector>
-#include <future>
-#include <thread>
+#include <memory>
 
 struct ImageData {
     unsigned char* data;
@@ -14,6 +15,25 @@ struct ImageData {
     std::string path;
 };
 
+// texture named by a material, path is relative to the model's directory
+struct TextureRef {
+    std::string type; // sampler prefix, e.g. texture_diffuse
+    std::string path;
+};
+
+// owns a GL texture name, deleted together with the last Texture sharing it
+struct TextureStorage {
+    TextureStorage(GLuint id) : id(id) {}
+    ~TextureStorage() {
+        GLState::forget_texture(this->id);
+        glDeleteTextures(1, &this->id);
+    }
+    TextureStorage(const TextureStorage&) = delete;
+    TextureStorage& operator=(const TextureStorage&) = delete;
+
+    GLuint id;
+};
+
 class Texture {
 public:
     Texture() = default;
@@ -30,13 +50,20 @@ public:
 
     void set_type(Texture::Type type);
 
-    static std::vector<Texture> load_textures(std::vector<std::string> image_paths);
-    static Texture load_cubemap(const std::vector<std::string>& faces, int texture_unit = 0);
+    // decodes on the shared thread pool and uploads on the calling thread as images finish
+    static std::vector<Texture> load_textures(std::vector<std::string> image_paths, bool flip_vertically = true);
+    // loads the block-compressed .ctex cooked from image_path, false if there is none or it is stale
+    static bool load_cooked(const std::string& image_path, bool flip_vertically, Texture& texture);
+    static Texture load_cubemap(const std::vector<std::string>& faces);
+    // sized format for 8-bit pixels in format. Unsized textures can't be copied into MaterialTable's arrays
+    static GLenum get_internal_format(GLenum format);
 
-    GLuint id;
+    GLuint id; // not tied to a unit, GLState::bind_texture picks one when sampling
     int width, height, n_channels;
-    int unit; // active shader slot for setting shader uniforms
-    static inline int num_textures = 0;
+    // decoded bytes load_textures has in flight at once, the rest of a batch is submitted as uploads free some
+    static inline size_t decode_budget = 256 * 1024 * 1024;
     std::string type;
     std::string path;
+    // set for textures handed out by TextureCache, plain textures are never deleted
+    std::shared_ptr<TextureStorage> storage;
 };
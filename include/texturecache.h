@@ -0,0 +1,35 @@
+#pragma once
+
+#include "texture.h"
+#include "texturestreamer.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+// Engine-wide texture cache keyed by canonical image path and load flags. Every Texture it hands out
+// shares ownership of the GL texture, which is deleted when the last one is destroyed. The cache itself
+// only holds weak references, so an unused texture is reloaded on its next request.
+class TextureCache {
+public:
+    // Decodes every path not yet cached in one concurrent batch, the result matches image_paths. With a
+    // streamer, misses return at once as placeholders and fill in over the following frames instead.
+    static Texture load(const std::string& image_path, bool flip_vertically = true, TextureStreamer* streamer = nullptr);
+    static std::vector<Texture> load(const std::vector<std::string>& image_paths, bool flip_vertically = true,
+        TextureStreamer* streamer = nullptr);
+
+    // number of cached textures that are still referenced
+    static size_t get_texture_count();
+
+private:
+    struct Entry {
+        Texture texture; // metadata only, its storage stays empty so the cache never keeps it alive
+        std::weak_ptr<TextureStorage> storage;
+    };
+
+    static std::string make_key(const std::string& image_path, bool flip_vertically);
+    static bool find(const std::string& key, Texture& texture);
+
+    static inline std::unordered_map<std::string, Entry> entries;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "texture.h"
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+// Loads textures without blocking the frame. A requested texture is usable right away as a 1x1 grey
+// placeholder stored in mip level 1 (base and max level both 1), while the image decodes on the shared
+// thread pool. update() then copies decoded rows into level 0 through a ring of pixel buffer segments, at
+// most upload_budget bytes per frame, and switches the texture over to its full mip chain once every row
+// has arrived.
+//
+// The ring is persistently mapped when the context supports GL 4.4, otherwise each segment is mapped
+// unsynchronized for the frame. Either way a fence per segment keeps the CPU from overwriting rows the
+// GPU has not copied yet.
+class TextureStreamer {
+public:
+    TextureStreamer(size_t upload_budget = 4 * 1024 * 1024);
+    ~TextureStreamer();
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // the returned texture owns its storage, width and height stay those of the placeholder
+    Texture request(const std::string& image_path, bool flip_vertically = true);
+    // uploads the next rows, call once per frame on the GL thread
+    void update();
+
+    size_t get_pending_count() const { return this->pending_count; }
+    size_t get_uploaded_bytes() const { return this->uploaded_bytes; } // during the last update
+    size_t get_finished_count() const { return this->finished_count; } // textures completed so far
+
+private:
+    static constexpr int segment_count = 3;
+
+    struct DecodedImage {
+        std::weak_ptr<TextureStorage> storage; // the upload is dropped if every Texture is gone
+        ImageData image;
+    };
+
+    // shared with the decode jobs, which may finish after the streamer is destroyed
+    struct DecodeQueue {
+        std::mutex mutex;
+        std::vector<DecodedImage> images;
+        bool closed = false;
+    };
+
+    struct Upload {
+        DecodedImage decoded;
+        GLenum format;
+        size_t row_bytes;
+        int next_row = 0;
+    };
+
+    void finish(const Upload& upload);
+
+    GLuint buffer = 0;
+    unsigned char* mapping = nullptr; // whole ring, null if segments are mapped every frame
+    GLsync fences[segment_count] = {};
+    int segment = 0;
+    size_t upload_budget;
+
+    std::shared_ptr<DecodeQueue> queue;
+    std::deque<Upload> uploads;
+    size_t pending_count = 0;
+    size_t uploaded_bytes = 0;
+    size_t finished_count = 0;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Fixed set of worker threads pulling jobs from a shared queue. Callers synchronize on their jobs' results
+// themselves; the pool only guarantees that every submitted job runs before it is destroyed. Thread-local
+// state a job changes, such as stb_image's per-thread flip flag, is still set for the next job on that worker.
+class ThreadPool {
+public:
+    ThreadPool(size_t thread_count);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> job);
+    size_t size() const { return this->workers.size(); }
+
+    // process-wide pool with one worker per hardware thread
+    static ThreadPool& shared();
+
+private:
+    void work();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+};
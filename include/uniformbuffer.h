@@ -0,0 +1,98 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+// binding points of the uniform blocks shared by all programs. Shader::link binds any active block
+// whose name appears here, so shaders only need to declare the block to receive the data.
+enum UniformBlock : GLuint {
+    CameraBlock = 0,
+    LightsBlock = 1,
+};
+
+struct UniformBlockBinding {
+    const char* name;
+    GLuint binding;
+};
+
+inline constexpr UniformBlockBinding uniform_block_bindings[] = {
+    {"Camera", UniformBlock::CameraBlock},
+    {"Lights", UniformBlock::LightsBlock},
+};
+
+// CPU mirrors of the std140 blocks declared in assets/shaders/*.glsl. vec3 members are 16-byte aligned
+// under std140, and a scalar following a vec3 packs into its last 4 bytes, which alignas(16) reproduces.
+struct CameraData {
+    alignas(16) glm::mat4 view;
+    alignas(16) glm::mat4 projection;
+    alignas(16) glm::vec3 view_pos;
+};
+
+struct DirLightData {
+    alignas(16) glm::vec3 direction;
+    alignas(16) glm::vec3 ambient;
+    alignas(16) glm::vec3 diffuse;
+    alignas(16) glm::vec3 specular;
+};
+
+struct PointLightData {
+    alignas(16) glm::vec3 position;
+    alignas(16) glm::vec3 ambient;
+    alignas(16) glm::vec3 diffuse;
+    alignas(16) glm::vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct SpotLightData {
+    alignas(16) glm::vec3 position;
+    alignas(16) glm::vec3 direction;
+    float cutoff;
+    float outer_cutoff;
+    alignas(16) glm::vec3 ambient;
+    alignas(16) glm::vec3 diffuse;
+    alignas(16) glm::vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+constexpr int n_point_lights = 4; // must match N_POINT_LIGHTS in box_fragment.glsl
+
+struct LightsData {
+    DirLightData dir_light;
+    PointLightData point_lights[n_point_lights];
+    SpotLightData spot_light;
+};
+
+static_assert(sizeof(CameraData) == 144, "CameraData does not match std140 layout");
+static_assert(sizeof(DirLightData) == 64, "DirLightData does not match std140 layout");
+static_assert(sizeof(PointLightData) == 80, "PointLightData does not match std140 layout");
+static_assert(sizeof(SpotLightData) == 112, "SpotLightData does not match std140 layout");
+static_assert(sizeof(LightsData) == 496, "LightsData does not match std140 layout");
+
+class UniformBuffer {
+public:
+    UniformBuffer() { glGenBuffers(1, &this->id); }
+    // create destructor after implementing renderer class
+
+    void bind() { glBindBuffer(GL_UNIFORM_BUFFER, this->id); }
+    void unbind() { glBindBuffer(GL_UNIFORM_BUFFER, 0); }
+
+    // allocates storage for a T in the currently bound buffer and attaches it to a block binding point
+    template <typename T>
+    void allocate(UniformBlock binding) {
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, this->id);
+    }
+
+    // copies user-defined data into currently bound buffer
+    template <typename T>
+    void write_buffer_data(const T& data) {
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+    }
+
+    GLuint id;
+};
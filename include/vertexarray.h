@@ -2,13 +2,15 @@
 
 #include <glad/glad.h>
 
+#include "glstate.h"
+
 class VertexArray {
 public:
     VertexArray() { glGenVertexArrays(1, &this->id); }
     // create destructor after implementing renderer class
 
-    void bind() const { glBindVertexArray(this->id); }
-    void unbind() const { glBindVertexArray(0); }
+    void bind() const { GLState::bind_vertex_array(this->id); }
+    void unbind() const { GLState::bind_vertex_array(0); }
 
     GLuint id;
 };
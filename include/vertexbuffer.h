@@ -3,6 +3,7 @@
 #include <glad/glad.h>
 
 #include <vector>
+#include <cstddef>
 
 class VertexBuffer {
 public:
@@ -18,5 +19,11 @@ public:
         glBufferData(GL_ARRAY_BUFFER, buffer.size() * sizeof(T), buffer.data(), usage);
     }
 
+    // copies count elements starting at data, e.g. straight from a memory-mapped file
+    template <typename T>
+    void write_buffer_data(const T* data, size_t count, GLenum usage) {
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(T), data, usage);
+    }
+
     GLuint id;
 };
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "bounds.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 tex_coords;
+};
+
+enum class TexCoordEncoding : uint8_t {
+    Float,
+    Half,
+    Unorm16, // only for coordinates inside [0, 1], anything else falls back to Half
+};
+
+// Layout a mesh's vertices are stored in on the GPU, chosen when the mesh is built. The default is the
+// plain 32-byte Vertex. Packed attributes are decoded by the vertex fetch, except for octahedral normals
+// and quantized positions which need the defines from get_defines() in the vertex shader.
+//
+//   position    float3 (12 bytes) or unorm16 within the mesh bounds (8 bytes, one short of padding)
+//   normal      float3 (12 bytes) or octahedral in the xy of GL_INT_2_10_10_10_REV (4 bytes)
+//   tex coords  float2 (8 bytes), half2 or unorm16x2 (4 bytes)
+struct VertexFormat {
+    bool quantize_positions = false;
+    bool pack_normals = false;
+    TexCoordEncoding tex_coords = TexCoordEncoding::Float;
+
+    // 20 bytes, fits meshes sharing one buffer since positions need no per-mesh bounds
+    static VertexFormat packed() { return {false, true, TexCoordEncoding::Half}; }
+    // 16 bytes, the vertex shader needs the mesh bounds to reconstruct positions
+    static VertexFormat quantized() { return {true, true, TexCoordEncoding::Half}; }
+
+    bool operator==(const VertexFormat& other) const {
+        return this->quantize_positions == other.quantize_positions && this->pack_normals == other.pack_normals
+            && this->tex_coords == other.tex_coords;
+    }
+
+    GLsizei get_stride() const { return this->get_tex_coords_offset() + this->get_tex_coords_size(); }
+    GLsizei get_normal_offset() const { return this->quantize_positions ? 8 : 12; }
+    GLsizei get_tex_coords_offset() const { return this->get_normal_offset() + (this->pack_normals ? 4 : 12); }
+    GLsizei get_tex_coords_size() const { return this->tex_coords == TexCoordEncoding::Float ? 8 : 4; }
+
+    // the format actually used for these vertices, Unorm16 tex coords outside [0, 1] become Half
+    VertexFormat resolve(const Vertex* vertices, size_t count) const;
+    std::vector<std::string> get_defines() const;
+
+    // bounds are only read when positions are quantized
+    std::vector<uint8_t> pack(const Vertex* vertices, size_t count, const BoundingBox& bounds) const;
+    Vertex unpack(const uint8_t* packed_vertex, const BoundingBox& bounds) const;
+
+    // describes this layout to the currently bound vertex array and vertex buffer
+    void setup_attributes() const;
+
+    // octahedral mapping of a unit vector to the [-1, 1] square and back, as done in the vertex shader
+    static glm::vec2 encode_octahedral(const glm::vec3& normal);
+    static glm::vec3 decode_octahedral(const glm::vec2& encoded);
+};
@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 
 #include <iostream>
+#include <chrono>
 #include <string>
 #include <cstdio>
 #include <algorithm>
@@ -14,8 +15,16 @@ struct WindowState {
     bool is_wireframe = false;
     bool tab_key_released = true;
     bool show_debug = false;
+    bool use_indirect = false;
+    bool use_bvh = true;
+    bool use_meshlet_culling = true;
+    bool use_occlusion_culling = true;
+    bool use_software_occlusion = false; // rasterize the occluders on the CPU instead of reading back the depth
+    float lod_error_pixels = 1.0f; // largest simplification error allowed on screen
     bool e_key_released = true;
     bool first_mouse = true;
+    bool mouse_left_released = true;
+    bool pick_requested = false;
     float mix = 0.0f;
 
     glm::vec3 camera_pos = {0.0f, 0.0f, 3.0f};
@@ -34,6 +43,10 @@ struct WindowState {
     int last_x;
     int last_y;
 
+    // cursor position of the last click, the screen center while the cursor is captured
+    double pick_x;
+    double pick_y;
+
     glm::vec3 dirlight_ambient = {0.05f, 0.05f, 0.05f};
     glm::vec3 dirlight_diffuse = {0.4f, 0.4f, 0.4f};
     glm::vec3 dirlight_specular = {0.5f, 0.5f, 0.5f};
@@ -53,16 +66,33 @@ struct WindowState {
 
 class Window {
 public:
-    Window(int width, int height, std::string title);
-    bool should_close() { return glfwWindowShouldClose(this->ptr); }
+    // a headless window has no display, it gets an EGL context without a surface and can only render into
+    // framebuffers. On machines without a GPU, Mesa's llvmpipe renders on the CPU
+    Window(int width, int height, std::string title, bool headless = false);
+    ~Window();
+    Window(const Window&) = delete;
+    Window& operator=(const Window&) = delete;
+
+    bool should_close() { return !this->headless && glfwWindowShouldClose(this->ptr); }
+    bool is_headless() const { return this->headless; }
     void process_input();
+    double get_time() const; // seconds since the window was created
 
     int width, height;
     std::string title;
-    GLFWwindow* ptr;
+    GLFWwindow* ptr = nullptr; // null when headless
     WindowState state;
 
 private:
+    void create_window();
+    void create_headless_context();
+
+    bool headless;
+    std::chrono::steady_clock::time_point start_time;
+    // EGLDisplay and EGLContext, opaque so only window.cpp needs the EGL headers
+    void* egl_display = nullptr;
+    void* egl_context = nullptr;
+
     static void framebuffer_size_callback(GLFWwindow* window, int width, int height);
     static void error_message_callback(GLenum source, GLenum type, GLuint id, GLenum severity,
             GLsizei length, const GLchar* message, const void* userParam);
@@ -0,0 +1,112 @@
+#include "benchmark.h"
+
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+#include <glm/gtc/constants.hpp>
+
+void Benchmark::run(Window& window, Renderer& renderer, const BenchmarkOptions& options) {
+    // a fixed count alone would let slow decodes leak uploads and placeholder textures into the measured frames
+    int warmup_frames = 0;
+    while (warmup_frames < options.warmup_frames || renderer.get_streaming_count() > 0) {
+        Benchmark::render_frame(window, renderer, 0.0f);
+        warmup_frames++;
+    }
+
+    std::vector<FrameTiming> timings;
+    timings.reserve(options.frames);
+    for (int frame = 0; frame < options.frames; frame++) {
+        timings.push_back(Benchmark::render_frame(window, renderer, 2.0f * glm::pi<float>() * frame / options.frames));
+    }
+
+    std::printf("Benchmark: %d frames at %dx%d on %s (%d warmup)\n", options.frames, window.width, window.height,
+                reinterpret_cast<const char*>(glGetString(GL_RENDERER)), warmup_frames);
+    if (timings.empty()) {
+        return;
+    }
+
+    auto collect = [&timings](auto field) {
+        std::vector<float> values;
+        for (const FrameTiming& timing : timings) {
+            values.push_back(field(timing));
+        }
+        return values;
+    };
+    Benchmark::print_summary("frame", collect([](const FrameTiming& t) { return t.frame_time; }));
+    Benchmark::print_summary("update", collect([](const FrameTiming& t) { return t.update_time; }));
+    Benchmark::print_summary("render", collect([](const FrameTiming& t) { return t.render_time; }));
+    Benchmark::print_summary("scene", collect([](const FrameTiming& t) { return t.stats.scene_update_time; }));
+    Benchmark::print_summary("culling", collect([](const FrameTiming& t) { return t.stats.cull_time; }));
+    Benchmark::print_summary("occlusion", collect([](const FrameTiming& t) { return t.stats.occlusion_time; }));
+
+    const FrameTiming& last = timings.back();
+    std::printf("  last frame: %d draw calls, %zu visible, %zu occluded\n", last.draw_calls,
+                last.stats.visible_count, last.stats.occluded_count);
+
+    if (!options.timings_path.empty() && Benchmark::write_timings(options.timings_path, timings)) {
+        std::printf("  timings written to %s\n", options.timings_path.c_str());
+    }
+    if (!options.image_path.empty() && renderer.save_image(options.image_path)) {
+        std::printf("  last frame written to %s\n", options.image_path.c_str());
+    }
+}
+
+Benchmark::FrameTiming Benchmark::render_frame(Window& window, Renderer& renderer, float angle) {
+    Benchmark::set_camera(window.state, angle);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    renderer.update();
+    auto update_end = std::chrono::high_resolution_clock::now();
+    renderer.render();
+    auto render_end = std::chrono::high_resolution_clock::now();
+    glFinish();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return {
+        std::chrono::duration<float, std::milli>(update_end - start).count(),
+        std::chrono::duration<float, std::milli>(render_end - update_end).count(),
+        std::chrono::duration<float, std::milli>(end - start).count(),
+        GLState::draw_calls,
+        renderer.get_frame_stats()
+    };
+}
+
+void Benchmark::set_camera(WindowState& state, float angle) {
+    constexpr float radius = 6.0f;
+    constexpr float height = 1.5f;
+    state.camera_pos = glm::vec3(radius * std::sin(angle), height, radius * std::cos(angle));
+    state.camera_front = glm::normalize(-state.camera_pos);
+
+    // kept in step so the camera does not jump when the same state drives an interactive window
+    state.pitch = glm::degrees(std::asin(state.camera_front.y));
+    state.yaw = glm::degrees(std::atan2(state.camera_front.z, state.camera_front.x));
+}
+
+void Benchmark::print_summary(const char* name, std::vector<float> times) {
+    std::sort(times.begin(), times.end());
+    float mean = std::accumulate(times.begin(), times.end(), 0.0f) / times.size();
+    float median = times[times.size() / 2];
+    float p95 = times[std::min(times.size() * 95 / 100, times.size() - 1)];
+    std::printf("  %-10s mean %8.3f ms, median %8.3f ms, p95 %8.3f ms, max %8.3f ms\n", name, mean, median, p95,
+                times.back());
+}
+
+bool Benchmark::write_timings(const std::string& path, const std::vector<FrameTiming>& timings) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    file << "frame,frame_ms,update_ms,render_ms,scene_ms,cull_ms,occlusion_ms,draw_calls,visible,occluded\n";
+    for (size_t i = 0; i < timings.size(); i++) {
+        const FrameTiming& t = timings[i];
+        file << i << "," << t.frame_time << "," << t.update_time << "," << t.render_time << ","
+             << t.stats.scene_update_time << "," << t.stats.cull_time << "," << t.stats.occlusion_time << ","
+             << t.draw_calls << "," << t.stats.visible_count << "," << t.stats.occluded_count << "\n";
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,388 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <limits>
+
+static BoundingBox combine(const BoundingBox& a, const BoundingBox& b) {
+    BoundingBox result = a;
+    result.expand(b);
+    return result;
+}
+
+static float surface_area(const BoundingBox& box) {
+    glm::vec3 size = box.max - box.min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+int BVH::allocate_node() {
+    if (this->free_list == null_node) {
+        this->nodes.emplace_back();
+        return static_cast<int>(this->nodes.size() - 1);
+    }
+
+    int node = this->free_list;
+    this->free_list = this->nodes[node].parent;
+    this->nodes[node] = Node();
+    return node;
+}
+
+void BVH::free_node(int node) {
+    this->nodes[node].parent = this->free_list;
+    this->nodes[node].height = -1;
+    this->free_list = node;
+}
+
+int BVH::insert(const BoundingBox& box, uint32_t user_data) {
+    int leaf = this->allocate_node();
+    Node& node = this->nodes[leaf];
+
+    node.tight = box;
+    node.box = {box.min - glm::vec3(this->fat_margin), box.max + glm::vec3(this->fat_margin)};
+    node.user_data = user_data;
+    node.height = 0;
+
+    this->insert_leaf(leaf);
+    this->leaf_count++;
+    return leaf;
+}
+
+void BVH::remove(int proxy) {
+    this->remove_leaf(proxy);
+    this->free_node(proxy);
+    this->leaf_count--;
+}
+
+bool BVH::update(int proxy, const BoundingBox& box) {
+    Node& node = this->nodes[proxy];
+    node.tight = box;
+
+    // still inside the fat box, the tree structure does not need to change
+    if (node.box.contains(box)) {
+        return false;
+    }
+
+    this->remove_leaf(proxy);
+    this->nodes[proxy].box = {box.min - glm::vec3(this->fat_margin), box.max + glm::vec3(this->fat_margin)};
+    this->insert_leaf(proxy);
+    return true;
+}
+
+void BVH::clear() {
+    this->nodes.clear();
+    this->root = null_node;
+    this->free_list = null_node;
+    this->leaf_count = 0;
+}
+
+void BVH::insert_leaf(int leaf) {
+    if (this->root == null_node) {
+        this->root = leaf;
+        this->nodes[leaf].parent = null_node;
+        return;
+    }
+
+    // descend towards the sibling that minimizes the surface area heuristic cost
+    BoundingBox leaf_box = this->nodes[leaf].box;
+    int index = this->root;
+
+    while (!this->nodes[index].is_leaf()) {
+        const Node& node = this->nodes[index];
+        float area = surface_area(node.box);
+        float combined_area = surface_area(combine(node.box, leaf_box));
+
+        // cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * combined_area;
+        // minimum cost of pushing the leaf further down the tree
+        float inheritance_cost = 2.0f * (combined_area - area);
+
+        auto descend_cost = [&](int child) {
+            const Node& child_node = this->nodes[child];
+            float new_area = surface_area(combine(child_node.box, leaf_box));
+            if (child_node.is_leaf()) {
+                return new_area + inheritance_cost;
+            }
+            return new_area - surface_area(child_node.box) + inheritance_cost;
+        };
+
+        float left_cost = descend_cost(node.left);
+        float right_cost = descend_cost(node.right);
+
+        if (cost < left_cost && cost < right_cost) {
+            break;
+        }
+        index = left_cost < right_cost ? node.left : node.right;
+    }
+
+    int sibling = index;
+    int old_parent = this->nodes[sibling].parent;
+    int new_parent = this->allocate_node();
+
+    this->nodes[new_parent].parent = old_parent;
+    this->nodes[new_parent].box = combine(leaf_box, this->nodes[sibling].box);
+    this->nodes[new_parent].height = this->nodes[sibling].height + 1;
+    this->nodes[new_parent].left = sibling;
+    this->nodes[new_parent].right = leaf;
+    this->nodes[sibling].parent = new_parent;
+    this->nodes[leaf].parent = new_parent;
+
+    if (old_parent == null_node) {
+        this->root = new_parent;
+    } else if (this->nodes[old_parent].left == sibling) {
+        this->nodes[old_parent].left = new_parent;
+    } else {
+        this->nodes[old_parent].right = new_parent;
+    }
+
+    this->refit_ancestors(this->nodes[leaf].parent);
+}
+
+void BVH::remove_leaf(int leaf) {
+    if (leaf == this->root) {
+        this->root = null_node;
+        return;
+    }
+
+    int parent = this->nodes[leaf].parent;
+    int grandparent = this->nodes[parent].parent;
+    int sibling = this->nodes[parent].left == leaf ? this->nodes[parent].right : this->nodes[parent].left;
+
+    // replace the parent with the sibling
+    if (grandparent == null_node) {
+        this->root = sibling;
+        this->nodes[sibling].parent = null_node;
+        this->free_node(parent);
+        return;
+    }
+
+    if (this->nodes[grandparent].left == parent) {
+        this->nodes[grandparent].left = sibling;
+    } else {
+        this->nodes[grandparent].right = sibling;
+    }
+    this->nodes[sibling].parent = grandparent;
+    this->free_node(parent);
+
+    this->refit_ancestors(grandparent);
+}
+
+void BVH::refit_ancestors(int index) {
+    while (index != null_node) {
+        index = this->balance(index);
+
+        Node& node = this->nodes[index];
+        const Node& left = this->nodes[node.left];
+        const Node& right = this->nodes[node.right];
+
+        node.height = 1 + std::max(left.height, right.height);
+        node.box = combine(left.box, right.box);
+
+        index = node.parent;
+    }
+}
+
+int BVH::balance(int index_a) {
+    // performs a left or right rotation if node A is imbalanced, returns the new root of the subtree
+    Node& a = this->nodes[index_a];
+    if (a.is_leaf() || a.height < 2) {
+        return index_a;
+    }
+
+    int index_b = a.left;
+    int index_c = a.right;
+    Node& b = this->nodes[index_b];
+    Node& c = this->nodes[index_c];
+
+    int balance = c.height - b.height;
+
+    // rotate C up
+    if (balance > 1) {
+        int index_f = c.left;
+        int index_g = c.right;
+        Node& f = this->nodes[index_f];
+        Node& g = this->nodes[index_g];
+
+        // swap A and C
+        c.left = index_a;
+        c.parent = a.parent;
+        a.parent = index_c;
+
+        // A's old parent should point to C
+        if (c.parent == null_node) {
+            this->root = index_c;
+        } else if (this->nodes[c.parent].left == index_a) {
+            this->nodes[c.parent].left = index_c;
+        } else {
+            this->nodes[c.parent].right = index_c;
+        }
+
+        // keep the taller of C's children as C's child
+        if (f.height > g.height) {
+            c.right = index_f;
+            a.right = index_g;
+            g.parent = index_a;
+            a.box = combine(b.box, g.box);
+            c.box = combine(a.box, f.box);
+            a.height = 1 + std::max(b.height, g.height);
+            c.height = 1 + std::max(a.height, f.height);
+        } else {
+            c.right = index_g;
+            a.right = index_f;
+            f.parent = index_a;
+            a.box = combine(b.box, f.box);
+            c.box = combine(a.box, g.box);
+            a.height = 1 + std::max(b.height, f.height);
+            c.height = 1 + std::max(a.height, g.height);
+        }
+        return index_c;
+    }
+
+    // rotate B up
+    if (balance < -1) {
+        int index_d = b.left;
+        int index_e = b.right;
+        Node& d = this->nodes[index_d];
+        Node& e = this->nodes[index_e];
+
+        // swap A and B
+        b.left = index_a;
+        b.parent = a.parent;
+        a.parent = index_b;
+
+        // A's old parent should point to B
+        if (b.parent == null_node) {
+            this->root = index_b;
+        } else if (this->nodes[b.parent].left == index_a) {
+            this->nodes[b.parent].left = index_b;
+        } else {
+            this->nodes[b.parent].right = index_b;
+        }
+
+        // keep the taller of B's children as B's child
+        if (d.height > e.height) {
+            b.right = index_d;
+            a.left = index_e;
+            e.parent = index_a;
+            a.box = combine(c.box, e.box);
+            b.box = combine(a.box, d.box);
+            a.height = 1 + std::max(c.height, e.height);
+            b.height = 1 + std::max(a.height, d.height);
+        } else {
+            b.right = index_e;
+            a.left = index_d;
+            d.parent = index_a;
+            a.box = combine(c.box, d.box);
+            b.box = combine(a.box, e.box);
+            a.height = 1 + std::max(c.height, d.height);
+            b.height = 1 + std::max(a.height, e.height);
+        }
+        return index_b;
+    }
+
+    return index_a;
+}
+
+enum class Containment { Outside, Intersecting, Inside };
+
+static Containment classify(const Frustum& frustum, const BoundingBox& box) {
+    glm::vec3 center = box.center();
+    glm::vec3 extents = box.extents();
+    Containment result = Containment::Inside;
+
+    for (const glm::vec4& plane : frustum.planes) {
+        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+
+        if (distance + radius < 0.0f) {
+            return Containment::Outside;
+        }
+        if (distance - radius < 0.0f) {
+            result = Containment::Intersecting;
+        }
+    }
+    return result;
+}
+
+void BVH::query_frustum(const Frustum& frustum, std::vector<uint32_t>& results) const {
+    if (this->root == null_node) {
+        return;
+    }
+
+    // the second element marks subtrees already known to be fully inside, which skip all further tests
+    std::vector<std::pair<int, bool>> stack;
+    stack.push_back({this->root, false});
+
+    while (!stack.empty()) {
+        auto [index, is_inside] = stack.back();
+        stack.pop_back();
+        const Node& node = this->nodes[index];
+
+        if (!is_inside) {
+            Containment containment = classify(frustum, node.is_leaf() ? node.tight : node.box);
+            if (containment == Containment::Outside) {
+                continue;
+            }
+            is_inside = containment == Containment::Inside;
+        }
+
+        if (node.is_leaf()) {
+            results.push_back(node.user_data);
+        } else {
+            stack.push_back({node.left, is_inside});
+            stack.push_back({node.right, is_inside});
+        }
+    }
+}
+
+// slab test, returns the entry distance along the ray or infinity on a miss
+static float intersect_ray(const glm::vec3& origin, const glm::vec3& inverse_direction, const BoundingBox& box) {
+    float t_min = 0.0f;
+    float t_max = std::numeric_limits<float>::infinity();
+
+    for (int i = 0; i < 3; i++) {
+        float t0 = (box.min[i] - origin[i]) * inverse_direction[i];
+        float t1 = (box.max[i] - origin[i]) * inverse_direction[i];
+        t_min = std::max(t_min, std::min(t0, t1));
+        t_max = std::min(t_max, std::max(t0, t1));
+    }
+    return t_min <= t_max ? t_min : std::numeric_limits<float>::infinity();
+}
+
+bool BVH::raycast(const glm::vec3& origin, const glm::vec3& direction, uint32_t& hit, float& distance,
+                  const std::function<bool(uint32_t)>& accept) const {
+    if (this->root == null_node) {
+        return false;
+    }
+
+    glm::vec3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    float nearest = std::numeric_limits<float>::infinity();
+    bool found = false;
+
+    std::vector<int> stack;
+    stack.push_back(this->root);
+
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+        const Node& node = this->nodes[index];
+
+        // skip subtrees that cannot contain a hit closer than the best one so far
+        float t = intersect_ray(origin, inverse_direction, node.is_leaf() ? node.tight : node.box);
+        if (t >= nearest) {
+            continue;
+        }
+
+        if (node.is_leaf()) {
+            if (!accept || accept(node.user_data)) {
+                nearest = t;
+                hit = node.user_data;
+                found = true;
+            }
+        } else {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+
+    distance = nearest;
+    return found;
+}
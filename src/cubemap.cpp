@@ -45,10 +45,11 @@ constexpr float cubemap_vertices[] = {
      1.0f, -1.0f,  1.0f
 };
 
-CubeMap::CubeMap(const std::vector<std::string>& faces, int texture_unit)
-    : texture(Texture::load_cubemap(faces, texture_unit)),
+CubeMap::CubeMap(const std::vector<std::string>& faces)
+    : texture(Texture::load_cubemap(faces)),
     shader("assets/shaders/skybox_vertex.glsl", "assets/shaders/skybox_fragment.glsl") {
 
+    this->skybox_uniform = this->shader.get_uniform("skybox");
     this->VAO.bind();
 
     VertexBuffer VBO;
@@ -60,15 +61,12 @@ CubeMap::CubeMap(const std::vector<std::string>& faces, int texture_unit)
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 }
 
-void CubeMap::draw(const glm::mat4& view, const glm::mat4& projection) const {
+void CubeMap::draw() const {
     glDepthFunc(GL_LEQUAL);
     this->shader.use();
-    this->shader.set("view", glm::mat4(glm::mat3(view))); // discard translation
-    this->shader.set("projection", projection);
 
     this->VAO.bind();
-    glActiveTexture(this->texture.unit);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, this->texture.id);
+    this->shader.set(this->skybox_uniform, static_cast<int>(GLState::bind_texture(GL_TEXTURE_CUBE_MAP, this->texture.id)));
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glDepthFunc(GL_LESS);
 }
@@ -1,5 +1,8 @@
 #include "framebuffer.h"
 
+#include <fstream>
+#include <vector>
+
 Framebuffer::Framebuffer(int width, int height)
     : width(width), height(height), colorbuffer(width, height) {
     glGenFramebuffers(1, &this->id);
@@ -8,19 +11,20 @@ Framebuffer::Framebuffer(int width, int height)
     // Attach empty texture to current framebuffer
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->colorbuffer.id, 0);
 
-    // Create a renderbuffer object with both depth and stencil attachments
-    glGenRenderbuffers(1, &this->renderbuffer);
-    glBindRenderbuffer(GL_RENDERBUFFER, this->renderbuffer);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    // Create a depth and stencil texture, a texture rather than a renderbuffer so the depth can be sampled
+    glGenTextures(1, &this->depth_texture);
+    GLState::bind_for_upload(GL_TEXTURE_2D, this->depth_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-     // Attach renderbuffer object to depth and stencil attachment of framebuffer
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, this->renderbuffer);
+    // Attach it to the depth and stencil attachment of framebuffer
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, this->depth_texture, 0);
 
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         std::cerr << "[OpenGL] Framebuffer error: framebuffer is not complete." << std::endl;
         this->unbind();
     }
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
     // Create quad that fills the whole screen in NDC
     constexpr float quad_vertices[] = {
@@ -38,7 +42,7 @@ Framebuffer::Framebuffer(int width, int height)
     glGenVertexArrays(1, &this->quad_vertexarray);
     glGenBuffers(1, &quad_vertexbuffer);
 
-    glBindVertexArray(this->quad_vertexarray);
+    GLState::bind_vertex_array(this->quad_vertexarray);
     glBindBuffer(GL_ARRAY_BUFFER, quad_vertexbuffer);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), &quad_vertices, GL_STATIC_DRAW);
 
@@ -48,14 +52,34 @@ Framebuffer::Framebuffer(int width, int height)
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
     
     this->screen_shader = Shader("assets/shaders/framebuffer_vertex.glsl", "assets/shaders/framebuffer_fragment.glsl");
-    this->screen_shader.use();
-    this->screen_shader.set("screenTexture", this->colorbuffer.unit);
+    this->screen_texture_uniform = this->screen_shader.get_uniform("screenTexture");
 }
 
 void Framebuffer::draw_to_screen() {
-    glActiveTexture(GL_TEXTURE0 + this->colorbuffer.unit);
-    glBindTexture(GL_TEXTURE_2D, this->colorbuffer.id);
+    GLuint unit = GLState::bind_texture(GL_TEXTURE_2D, this->colorbuffer.id);
     this->screen_shader.use();
-    glBindVertexArray(this->quad_vertexarray);
+    this->screen_shader.set(this->screen_texture_uniform, static_cast<int>(unit));
+    GLState::bind_vertex_array(this->quad_vertexarray);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
+
+bool Framebuffer::save_ppm(const std::string& path) {
+    std::vector<unsigned char> pixels(this->width * this->height * 3);
+    this->bind();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, this->width, this->height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    // GL rows start at the bottom, PPM rows at the top
+    file << "P6\n" << this->width << " " << this->height << "\n255\n";
+    for (int y = this->height - 1; y >= 0; y--) {
+        file.write(reinterpret_cast<const char*>(&pixels[y * this->width * 3]), this->width * 3);
+    }
+    return static_cast<bool>(file);
+}
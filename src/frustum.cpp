@@ -0,0 +1,152 @@
+#include "frustum.h"
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+Frustum::Frustum(const glm::mat4& view_projection) {
+    // Gribb-Hartmann extraction, glm matrices are column major so row i is m[0][i], m[1][i], ...
+    auto row = [&view_projection](int i) {
+        return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+    };
+
+    this->planes[0] = row(3) + row(0);
+    this->planes[1] = row(3) - row(0);
+    this->planes[2] = row(3) + row(1);
+    this->planes[3] = row(3) - row(1);
+    this->planes[4] = row(3) + row(2);
+    this->planes[5] = row(3) - row(2);
+
+    for (glm::vec4& plane : this->planes) {
+        plane = plane / glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+    for (const glm::vec4& plane : this->planes) {
+        if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FrustumCuller::clear() {
+    this->count = 0;
+}
+
+void FrustumCuller::add(const BoundingBox& box) {
+    if (this->count == this->center_x.size()) {
+        size_t padded_size = this->center_x.size() + 8;
+        for (std::vector<float>* array : {&this->center_x, &this->center_y, &this->center_z,
+                                          &this->extent_x, &this->extent_y, &this->extent_z}) {
+            array->resize(padded_size, 0.0f);
+        }
+    }
+
+    glm::vec3 center = box.center();
+    glm::vec3 extents = box.extents();
+
+    this->center_x[this->count] = center.x;
+    this->center_y[this->count] = center.y;
+    this->center_z[this->count] = center.z;
+    this->extent_x[this->count] = extents.x;
+    this->extent_y[this->count] = extents.y;
+    this->extent_z[this->count] = extents.z;
+    this->count++;
+}
+
+size_t FrustumCuller::cull(const Frustum& frustum, std::vector<uint8_t>& visibility) const {
+    // a box is outside if it lies entirely behind any plane, i.e. when the distance of its center
+    // to the plane is less than minus the box's projected radius onto the plane normal
+    visibility.resize(this->center_x.size());
+    size_t i = 0;
+
+#if defined(__AVX__)
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+    for (; i + 8 <= this->center_x.size(); i += 8) {
+        __m256 cx = _mm256_loadu_ps(&this->center_x[i]);
+        __m256 cy = _mm256_loadu_ps(&this->center_y[i]);
+        __m256 cz = _mm256_loadu_ps(&this->center_z[i]);
+        __m256 ex = _mm256_loadu_ps(&this->extent_x[i]);
+        __m256 ey = _mm256_loadu_ps(&this->extent_y[i]);
+        __m256 ez = _mm256_loadu_ps(&this->extent_z[i]);
+        __m256 outside = _mm256_setzero_ps();
+
+        for (const glm::vec4& plane : frustum.planes) {
+            __m256 nx = _mm256_set1_ps(plane.x);
+            __m256 ny = _mm256_set1_ps(plane.y);
+            __m256 nz = _mm256_set1_ps(plane.z);
+
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(cx, nx), _mm256_set1_ps(plane.w));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(cy, ny));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(cz, nz));
+
+            __m256 radius = _mm256_mul_ps(ex, _mm256_andnot_ps(sign_mask, nx));
+            radius = _mm256_add_ps(radius, _mm256_mul_ps(ey, _mm256_andnot_ps(sign_mask, ny)));
+            radius = _mm256_add_ps(radius, _mm256_mul_ps(ez, _mm256_andnot_ps(sign_mask, nz)));
+
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(outside);
+        for (int j = 0; j < 8; j++) {
+            visibility[i + j] = !(mask & (1 << j));
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+    for (; i + 4 <= this->center_x.size(); i += 4) {
+        __m128 cx = _mm_loadu_ps(&this->center_x[i]);
+        __m128 cy = _mm_loadu_ps(&this->center_y[i]);
+        __m128 cz = _mm_loadu_ps(&this->center_z[i]);
+        __m128 ex = _mm_loadu_ps(&this->extent_x[i]);
+        __m128 ey = _mm_loadu_ps(&this->extent_y[i]);
+        __m128 ez = _mm_loadu_ps(&this->extent_z[i]);
+        __m128 outside = _mm_setzero_ps();
+
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 nx = _mm_set1_ps(plane.x);
+            __m128 ny = _mm_set1_ps(plane.y);
+            __m128 nz = _mm_set1_ps(plane.z);
+
+            __m128 distance = _mm_add_ps(_mm_mul_ps(cx, nx), _mm_set1_ps(plane.w));
+            distance = _mm_add_ps(distance, _mm_mul_ps(cy, ny));
+            distance = _mm_add_ps(distance, _mm_mul_ps(cz, nz));
+
+            __m128 radius = _mm_mul_ps(ex, _mm_andnot_ps(sign_mask, nx));
+            radius = _mm_add_ps(radius, _mm_mul_ps(ey, _mm_andnot_ps(sign_mask, ny)));
+            radius = _mm_add_ps(radius, _mm_mul_ps(ez, _mm_andnot_ps(sign_mask, nz)));
+
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int j = 0; j < 4; j++) {
+            visibility[i + j] = !(mask & (1 << j));
+        }
+    }
+#endif
+
+    // scalar path for targets without SSE
+    for (; i < this->center_x.size(); i++) {
+        bool outside = false;
+        for (const glm::vec4& plane : frustum.planes) {
+            float distance = this->center_x[i] * plane.x + this->center_y[i] * plane.y
+                           + this->center_z[i] * plane.z + plane.w;
+            float radius = this->extent_x[i] * std::fabs(plane.x) + this->extent_y[i] * std::fabs(plane.y)
+                         + this->extent_z[i] * std::fabs(plane.z);
+            outside |= distance + radius < 0.0f;
+        }
+        visibility[i] = !outside;
+    }
+
+    visibility.resize(this->count);
+    size_t n_visible = 0;
+    for (uint8_t visible : visibility) {
+        n_visible += visible;
+    }
+    return n_visible;
+}
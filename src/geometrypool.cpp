@@ -0,0 +1,74 @@
+#include "geometrypool.h"
+
+#include <numeric>
+#include <algorithm>
+
+MeshRange GeometryPool::add_mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices) {
+    MeshRange range = {
+        static_cast<GLuint>(this->indices.size()),
+        static_cast<GLuint>(indices.size()),
+        static_cast<GLint>(this->vertices.size())
+    };
+
+    this->vertices.insert(this->vertices.end(), vertices.begin(), vertices.end());
+    this->indices.insert(this->indices.end(), indices.begin(), indices.end());
+
+    return range;
+}
+
+void GeometryPool::upload(const VertexFormat& format) {
+    this->vertex_format = format.resolve(this->vertices.data(), this->vertices.size());
+    this->vertex_format.quantize_positions = false;
+
+    this->VAO.bind();
+    this->VBO.bind();
+    this->EBO.bind();
+
+    if (this->vertex_format == VertexFormat()) {
+        this->VBO.write_buffer_data(this->vertices, GL_STATIC_DRAW);
+    } else {
+        this->VBO.write_buffer_data(this->vertex_format.pack(this->vertices.data(), this->vertices.size(), {}),
+                                    GL_STATIC_DRAW);
+    }
+    this->EBO.write_buffer_data(this->indices, GL_STATIC_DRAW);
+    this->vertex_format.setup_attributes();
+
+    glVertexAttribIFormat(draw_index_attribute, 1, GL_UNSIGNED_INT, 0);
+    glVertexAttribBinding(draw_index_attribute, draw_index_binding);
+    glVertexBindingDivisor(draw_index_binding, 1);
+    glEnableVertexAttribArray(draw_index_attribute);
+    glBindVertexBuffer(draw_index_binding, this->draw_index_buffer.id, 0, sizeof(GLuint));
+
+    this->VAO.unbind();
+    glGenBuffers(1, &this->indirect_buffer);
+
+    // the GPU copy is all that is needed from here on
+    std::vector<Vertex>().swap(this->vertices);
+    std::vector<GLuint>().swap(this->indices);
+}
+
+void GeometryPool::write_commands(const std::vector<DrawElementsIndirectCommand>& commands) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->indirect_buffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand),
+                 commands.data(), GL_STREAM_DRAW);
+
+    // grow the identity buffer backing the draw index attribute, the VAO keeps referencing the same buffer
+    if (commands.size() > this->draw_index_capacity) {
+        this->draw_index_capacity = std::max<size_t>(commands.size(), 2 * this->draw_index_capacity);
+
+        std::vector<GLuint> draw_indices(this->draw_index_capacity);
+        std::iota(draw_indices.begin(), draw_indices.end(), 0);
+
+        this->draw_index_buffer.bind();
+        this->draw_index_buffer.write_buffer_data(draw_indices, GL_STATIC_DRAW);
+        this->draw_index_buffer.unbind();
+    }
+}
+
+void GeometryPool::draw(size_t first_command, GLsizei command_count) const {
+    this->VAO.bind();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->indirect_buffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                (void*)(first_command * sizeof(DrawElementsIndirectCommand)), command_count, 0);
+    GLState::draw_calls++;
+}
@@ -0,0 +1,226 @@
+#include "hizbuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+HiZBuffer::~HiZBuffer() {
+    if (this->fence) {
+        glDeleteSync(this->fence);
+    }
+    if (this->texture) {
+        GLState::forget_texture(this->texture);
+        glDeleteTextures(1, &this->texture);
+        glDeleteFramebuffers(1, &this->framebuffer);
+        glDeleteVertexArrays(1, &this->vertex_array);
+        glDeleteBuffers(1, &this->pixel_buffer);
+    }
+}
+
+void HiZBuffer::init(int width, int height) {
+    // halving down to 1x1, odd sizes round down and the last texel of a row or column takes in the remainder
+    this->sizes = {glm::ivec2(width, height)};
+    while (this->sizes.back().x > 1 || this->sizes.back().y > 1) {
+        this->sizes.push_back(glm::max(this->sizes.back() / 2, glm::ivec2(1)));
+    }
+
+    this->readback_level = 1;
+    while (this->readback_level + 1 < this->sizes.size() && this->sizes[this->readback_level].x > readback_width) {
+        this->readback_level++;
+    }
+    glm::ivec2 readback_size = this->sizes[this->readback_level];
+
+    glGenTextures(1, &this->texture);
+    GLState::bind_for_upload(GL_TEXTURE_2D, this->texture);
+    glTexStorage2D(GL_TEXTURE_2D, this->readback_level, GL_R32F, this->sizes[1].x, this->sizes[1].y);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &this->framebuffer);
+    glGenVertexArrays(1, &this->vertex_array);
+
+    glGenBuffers(1, &this->pixel_buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, this->pixel_buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, readback_size.x * readback_size.y * sizeof(float), nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    this->shader = Shader("assets/shaders/hiz_vertex.glsl", "assets/shaders/hiz_fragment.glsl");
+    this->source_uniform = this->shader.get_uniform("source");
+}
+
+void HiZBuffer::build(GLuint depth_texture, const glm::mat4& view_projection, uint64_t frame) {
+    if (this->fence) {
+        return;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    glDisable(GL_BLEND);
+    this->shader.use();
+    GLState::bind_vertex_array(this->vertex_array);
+
+    for (size_t level = 1; level <= this->readback_level; level++) {
+        // the source level is the only one visible to the sampler, so writing the next one is no feedback loop
+        GLuint source = depth_texture;
+        if (level > 1) {
+            source = this->texture;
+            GLState::bind_for_upload(GL_TEXTURE_2D, this->texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 2);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 2);
+        }
+        this->shader.set(this->source_uniform, static_cast<int>(GLState::bind_texture(GL_TEXTURE_2D, source)));
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->texture, level - 1);
+        glViewport(0, 0, this->sizes[level].x, this->sizes[level].y);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        GLState::draw_calls++;
+    }
+
+    // copied into the pixel buffer on the GPU timeline, the CPU maps it once the fence has passed
+    glm::ivec2 readback_size = this->sizes[this->readback_level];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, this->pixel_buffer);
+    glReadPixels(0, 0, readback_size.x, readback_size.y, GL_RED, GL_FLOAT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    this->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    this->pending_view_projection = view_projection;
+    this->pending_frame = frame;
+}
+
+bool HiZBuffer::update() {
+    if (!this->fence || glClientWaitSync(this->fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+    glDeleteSync(this->fence);
+    this->fence = nullptr;
+
+    size_t level_count = this->sizes.size() - this->readback_level;
+    this->levels.resize(level_count);
+    for (size_t i = 0; i < level_count; i++) {
+        glm::ivec2 size = this->sizes[this->readback_level + i];
+        this->levels[i].resize(size.x * size.y);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, this->pixel_buffer);
+    const void* mapping = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, this->levels[0].size() * sizeof(float),
+                                           GL_MAP_READ_BIT);
+    if (mapping) {
+        std::memcpy(this->levels[0].data(), mapping, this->levels[0].size() * sizeof(float));
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!mapping) {
+        this->levels.clear();
+        return false;
+    }
+
+    // the same reduction as hiz_fragment.glsl for the levels too small to be worth a GPU pass
+    for (size_t i = 1; i < level_count; i++) {
+        glm::ivec2 source_size = this->sizes[this->readback_level + i - 1];
+        glm::ivec2 size = this->sizes[this->readback_level + i];
+        const std::vector<float>& source = this->levels[i - 1];
+
+        for (int y = 0; y < size.y; y++) {
+            int y_end = y == size.y - 1 ? source_size.y : std::min(2 * y + 2, source_size.y);
+            for (int x = 0; x < size.x; x++) {
+                int x_end = x == size.x - 1 ? source_size.x : std::min(2 * x + 2, source_size.x);
+
+                float depth = 0.0f;
+                for (int source_y = 2 * y; source_y < y_end; source_y++) {
+                    for (int source_x = 2 * x; source_x < x_end; source_x++) {
+                        depth = std::max(depth, source[source_y * source_size.x + source_x]);
+                    }
+                }
+                this->levels[i][y * size.x + x] = depth;
+            }
+        }
+    }
+
+    this->view_projection = this->pending_view_projection;
+    this->frame = this->pending_frame;
+    return true;
+}
+
+void HiZBuffer::reset() {
+    if (this->fence) {
+        glDeleteSync(this->fence);
+        this->fence = nullptr;
+    }
+    this->levels.clear();
+}
+
+int HiZBuffer::get_texel(int pixel, size_t level, int axis) const {
+    for (size_t i = 1; i <= level; i++) {
+        pixel = std::min(pixel / 2, this->sizes[i][axis] - 1);
+    }
+    return pixel;
+}
+
+bool HiZBuffer::is_view_current(const glm::mat4& view_projection) const {
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            if (std::abs(view_projection[column][row] - this->view_projection[column][row]) > view_tolerance) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool HiZBuffer::is_occluded(const BoundingBox& box) const {
+    if (this->levels.empty()) {
+        return false;
+    }
+
+    glm::vec2 min_ndc = glm::vec2(1.0f);
+    glm::vec2 max_ndc = glm::vec2(-1.0f);
+    float min_depth = 1.0f;
+
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner = glm::vec3(i & 1 ? box.max.x : box.min.x,
+                                     i & 2 ? box.max.y : box.min.y,
+                                     i & 4 ? box.max.z : box.min.z);
+        glm::vec4 clip = this->view_projection * glm::vec4(corner, 1.0f);
+
+        // reaches behind the camera
+        if (clip.w <= 0.0f) {
+            return false;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        min_ndc = glm::min(min_ndc, glm::vec2(ndc));
+        max_ndc = glm::max(max_ndc, glm::vec2(ndc));
+        min_depth = std::min(min_depth, ndc.z * 0.5f + 0.5f);
+    }
+
+    // whatever lies outside the view the depth was rendered from may well be visible now
+    if (min_ndc.x < -1.0f || min_ndc.y < -1.0f || max_ndc.x > 1.0f || max_ndc.y > 1.0f) {
+        return false;
+    }
+
+    glm::ivec2 full_size = this->sizes[0];
+    glm::ivec2 min_pixel = glm::min(glm::ivec2((min_ndc * 0.5f + 0.5f) * glm::vec2(full_size)), full_size - 1);
+    glm::ivec2 max_pixel = glm::min(glm::ivec2((max_ndc * 0.5f + 0.5f) * glm::vec2(full_size)), full_size - 1);
+
+    // the finest level where the box covers at most 4x4 texels
+    size_t level = this->readback_level;
+    glm::ivec2 min_texel, max_texel;
+    while (true) {
+        min_texel = glm::ivec2(this->get_texel(min_pixel.x, level, 0), this->get_texel(min_pixel.y, level, 1));
+        max_texel = glm::ivec2(this->get_texel(max_pixel.x, level, 0), this->get_texel(max_pixel.y, level, 1));
+        if ((max_texel.x - min_texel.x < 4 && max_texel.y - min_texel.y < 4) || level + 1 == this->sizes.size()) {
+            break;
+        }
+        level++;
+    }
+
+    const std::vector<float>& depths = this->levels[level - this->readback_level];
+    int width = this->sizes[level].x;
+    float max_depth = 0.0f;
+    for (int y = min_texel.y; y <= max_texel.y; y++) {
+        for (int x = min_texel.x; x <= max_texel.x; x++) {
+            max_depth = std::max(max_depth, depths[y * width + x]);
+        }
+    }
+
+    // a little slack so a box does not hide behind the rounded depth of its own faces
+    constexpr float depth_bias = 1e-6f;
+    return min_depth > max_depth + depth_bias;
+}
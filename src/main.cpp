@@ -1,26 +1,61 @@
 #include "window.h"
 #include "renderer.h"
+#include "benchmark.h"
 
-int main(void) {
-    Window window(1920, 1080, "Graphics Engine");
-    Renderer renderer(&window);
+#include <cstring>
+#include <cstdlib>
 
-    renderer.init();
+int main(int argc, char** argv) {
+    // --headless renders a fixed number of frames without a display and prints their timings, see Benchmark
+    bool headless = false;
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (std::strcmp(argv[i], "--frames") == 0 && has_value) {
+            options.frames = std::max(std::atoi(argv[++i]), 1);
+        } else if (std::strcmp(argv[i], "--warmup") == 0 && has_value) {
+            options.warmup_frames = std::max(std::atoi(argv[++i]), 0);
+        } else if (std::strcmp(argv[i], "--image") == 0 && has_value) {
+            options.image_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--timings") == 0 && has_value) {
+            options.timings_path = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--headless [--frames N] [--warmup N] [--image out.ppm] [--timings out.csv]]" << std::endl;
+            return 1;
+        }
+    }
+
+    Window window(1920, 1080, "Graphics Engine", headless);
+
+    // scoped so GL resources owned by the renderer are released while the context still exists
+    {
+        Renderer renderer(&window);
 
-    while (!window.should_close()) {
-        window.process_input();
+        renderer.init();
 
-        renderer.update();
-        renderer.render();
-        renderer.render_ui();
+        if (headless) {
+            Benchmark::run(window, renderer, options);
+        } else {
+            while (!window.should_close()) {
+                window.process_input();
 
-        glfwSwapBuffers(window.ptr);
-        glfwPollEvents();
+                renderer.update();
+                renderer.render();
+                renderer.render_ui();
+
+                glfwSwapBuffers(window.ptr);
+                glfwPollEvents();
+            }
+        }
     }
 
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
-    glfwTerminate();
+    if (!headless) {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+    }
     return 0;
 }
@@ -0,0 +1,205 @@
+#include "materialtable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+MaterialTable::~MaterialTable() {
+    this->release();
+}
+
+void MaterialTable::release() {
+    for (const TextureArray& array : this->arrays) {
+        GLState::forget_texture(array.id);
+        glDeleteTextures(1, &array.id);
+    }
+    this->arrays.clear();
+}
+
+MaterialTable::SourceTexture MaterialTable::describe(GLuint texture) {
+    GLState::bind_for_upload(GL_TEXTURE_2D, texture);
+
+    SourceTexture source;
+    source.id = texture;
+    GLint max_level, internal_format;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, &source.base_level);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &max_level);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &source.wrap);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, source.base_level, GL_TEXTURE_WIDTH, &source.width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, source.base_level, GL_TEXTURE_HEIGHT, &source.height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, source.base_level, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+    GLState::bind_for_upload(GL_TEXTURE_2D, 0);
+
+    // glTexStorage3D only takes sized formats
+    switch (internal_format) {
+    case GL_RED:
+        internal_format = GL_R8; break;
+    case GL_RG:
+        internal_format = GL_RG8; break;
+    case GL_RGB:
+        internal_format = GL_RGB8; break;
+    case GL_RGBA:
+        internal_format = GL_RGBA8; break;
+    }
+    source.internal_format = internal_format;
+
+    // mipmapped textures leave the max level at its default, which is clamped to the full chain
+    GLsizei full_chain = static_cast<GLsizei>(std::log2(std::max(source.width, source.height))) + 1;
+    source.levels = std::min(max_level - source.base_level + 1, full_chain);
+    return source;
+}
+
+bool MaterialTable::is_compatible(const SourceTexture& a, const SourceTexture& b) {
+    return a.width == b.width && a.height == b.height && a.levels == b.levels
+        && a.internal_format == b.internal_format && a.wrap == b.wrap;
+}
+
+void MaterialTable::grow(TextureArray& array) {
+    const SourceTexture& format = array.format;
+    GLsizei capacity = std::max(static_cast<GLsizei>(array.layers.size()), array.capacity * 2);
+
+    GLuint id;
+    glGenTextures(1, &id);
+    GLState::bind_for_upload(GL_TEXTURE_2D_ARRAY, id);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, format.levels, format.internal_format, format.width, format.height,
+        capacity);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, format.wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, format.wrap);
+
+    // all old layers in one copy per level
+    if (array.id != 0) {
+        for (GLsizei level = 0; level < format.levels; level++) {
+            glCopyImageSubData(array.id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                std::max(format.width >> level, 1), std::max(format.height >> level, 1), array.capacity);
+        }
+        GLState::forget_texture(array.id);
+        glDeleteTextures(1, &array.id);
+    }
+
+    array.id = id;
+    array.capacity = capacity;
+}
+
+void MaterialTable::build(const std::vector<std::vector<Texture>>& materials) {
+    this->release();
+    this->update(materials);
+}
+
+void MaterialTable::update(const std::vector<std::vector<Texture>>& materials) {
+    this->material_arrays.assign(materials.size(), 0);
+    this->material_data.assign(materials.size(), {0});
+    std::vector<size_t> material_array_index(materials.size(), SIZE_MAX);
+
+    // layers referenced by a material, and those that need a copy from their source
+    std::vector<std::vector<bool>> used(this->arrays.size());
+    for (size_t a = 0; a < this->arrays.size(); a++) {
+        used[a].assign(this->arrays[a].layers.size(), false);
+    }
+    std::vector<std::pair<size_t, size_t>> copies;
+
+    for (size_t i = 0; i < materials.size(); i++) {
+        auto diffuse = std::find_if(materials[i].begin(), materials[i].end(),
+            [](const Texture& texture) { return texture.type == "texture_diffuse"; });
+        if (diffuse == materials[i].end()) {
+            continue;
+        }
+
+        // materials sharing a texture share its layer, which stays put while the texture is unchanged
+        SourceTexture source = this->describe(diffuse->id);
+        auto same_texture = [&source](const SourceTexture& other) { return other.id == source.id; };
+        size_t a = 0, layer = 0;
+        bool found = false;
+        for (a = 0; a < this->arrays.size(); a++) {
+            const std::vector<SourceTexture>& layers = this->arrays[a].layers;
+            layer = std::find_if(layers.begin(), layers.end(), same_texture) - layers.begin();
+            if (layer < layers.size()) {
+                found = true;
+                break;
+            }
+        }
+
+        // a streamed texture that finished has a new size, so it moves to another array
+        if (found && (this->arrays[a].layers[layer].base_level != source.base_level
+                      || !MaterialTable::is_compatible(this->arrays[a].layers[layer], source))) {
+            this->arrays[a].layers[layer].id = 0;
+            found = false;
+        }
+
+        if (!found) {
+            auto compatible = [&source](const TextureArray& array) {
+                return MaterialTable::is_compatible(array.format, source);
+            };
+            a = std::find_if(this->arrays.begin(), this->arrays.end(), compatible) - this->arrays.begin();
+            if (a == this->arrays.size()) {
+                this->arrays.push_back({0, source, 0, {}});
+                used.emplace_back();
+            }
+
+            // reuse a free layer before growing the array
+            std::vector<SourceTexture>& layers = this->arrays[a].layers;
+            layer = 0;
+            while (layer < layers.size() && (layers[layer].id != 0 || used[a][layer])) {
+                layer++;
+            }
+            if (layer == layers.size()) {
+                layers.emplace_back();
+                used[a].push_back(false);
+            }
+            layers[layer] = source;
+            copies.emplace_back(a, layer);
+        }
+
+        used[a][layer] = true;
+        this->material_data[i].diffuse_layer = layer;
+        material_array_index[i] = a;
+    }
+
+    // layers nobody samples any more are free for the next texture of their format
+    for (size_t a = 0; a < this->arrays.size(); a++) {
+        for (size_t layer = 0; layer < used[a].size(); layer++) {
+            if (!used[a][layer]) {
+                this->arrays[a].layers[layer].id = 0;
+            }
+        }
+        if (static_cast<GLsizei>(this->arrays[a].layers.size()) > this->arrays[a].capacity) {
+            MaterialTable::grow(this->arrays[a]);
+        }
+    }
+
+    // GPU-side copies, compressed textures stay compressed
+    for (const auto& [a, layer] : copies) {
+        const TextureArray& array = this->arrays[a];
+        const SourceTexture& source = array.layers[layer];
+        for (GLsizei level = 0; level < array.format.levels; level++) {
+            glCopyImageSubData(source.id, GL_TEXTURE_2D, source.base_level + level, 0, 0, 0,
+                array.id, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+                std::max(array.format.width >> level, 1), std::max(array.format.height >> level, 1), 1);
+        }
+    }
+    GLState::bind_for_upload(GL_TEXTURE_2D_ARRAY, 0);
+
+    for (size_t i = 0; i < materials.size(); i++) {
+        if (material_array_index[i] != SIZE_MAX) {
+            this->material_arrays[i] = this->arrays[material_array_index[i]].id;
+        }
+    }
+
+    // arrays left without layers, such as the one for placeholders once streaming is done, are dropped
+    this->layer_count = 0;
+    for (size_t a = this->arrays.size(); a-- > 0;) {
+        size_t layers = std::count(used[a].begin(), used[a].end(), true);
+        if (layers == 0) {
+            GLState::forget_texture(this->arrays[a].id);
+            glDeleteTextures(1, &this->arrays[a].id);
+            this->arrays.erase(this->arrays.begin() + a);
+        }
+        this->layer_count += layers;
+    }
+
+    this->storage.bind();
+    this->storage.write_buffer_data(this->material_data, GL_STATIC_DRAW);
+    this->storage.bind_base(StorageBlock::MaterialsStorage);
+    this->storage.unbind();
+}
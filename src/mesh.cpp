@@ -1,46 +1,177 @@
 #include "mesh.h"
+#include "meshcache.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures) {
-    // TODO: should the constructor arguments be passed by value?
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures,
+           const VertexFormat& format, std::vector<MeshLod> lods) {
+    // taken by value so callers can move their data in without a copy
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->textures = std::move(textures);
+    this->vertex_format = format;
+    this->lods = std::move(lods);
 
     setup_mesh();
 }
 
-Mesh::Mesh(const MeshData& mesh_data) : Mesh(mesh_data.vertices, mesh_data.indices, mesh_data.textures) {}
+Mesh::Mesh(const MeshData& mesh_data, const VertexFormat& format)
+    : Mesh(mesh_data.vertices, mesh_data.indices, mesh_data.textures, format, mesh_data.lods) {}
+
+Mesh::Mesh(const MeshView& mesh_view, std::vector<Texture> textures, const VertexFormat& format,
+           bool keep_cpu_data) {
+    this->textures = std::move(textures);
+    if (keep_cpu_data) {
+        this->vertices.assign(mesh_view.vertices, mesh_view.vertices + mesh_view.vertex_count);
+        this->indices.assign(mesh_view.indices, mesh_view.indices + mesh_view.index_count);
+    }
+    this->index_count = mesh_view.index_count;
+    this->lods = mesh_view.lods;
+    if (this->lods.empty()) {
+        this->lods.push_back({0, mesh_view.index_count, 0.0f});
+    }
+    this->bounds = mesh_view.bounds;
+    this->bounding_sphere = mesh_view.bounding_sphere;
+    this->vertex_format = format;
+
+    this->VAO.bind();
+    this->VBO.bind();
+    this->EBO.bind();
+
+    this->upload_vertices(mesh_view.vertices, mesh_view.vertex_count);
+    this->EBO.write_buffer_data(mesh_view.indices, mesh_view.index_count, GL_STATIC_DRAW);
+    this->vertex_format.setup_attributes();
+    setup_instance_attributes();
+
+    setup_sampler_names();
+}
 
 void Mesh::setup_mesh() {
+    this->index_count = this->indices.size();
+    if (this->lods.empty()) {
+        this->lods.push_back({0, static_cast<uint32_t>(this->index_count), 0.0f});
+    }
+    // quantized positions are relative to the bounds, so they are needed before packing
+    compute_bounds();
+
     this->VAO.bind();
     this->VBO.bind();
     this->EBO.bind();
 
-    this->VBO.write_buffer_data(this->vertices, GL_STATIC_DRAW);
+    this->upload_vertices(this->vertices.data(), this->vertices.size());
     this->EBO.write_buffer_data(this->indices, GL_STATIC_DRAW);
-    
-    // vertex positions
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // vertex normals
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(1);
-
-    // texture coordinates
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tex_coords));
-    glEnableVertexAttribArray(2);
+    this->vertex_format.setup_attributes();
+    setup_instance_attributes();
+
+    setup_sampler_names();
+}
+
+void Mesh::upload_vertices(const Vertex* vertices, size_t count) {
+    this->vertex_format = this->vertex_format.resolve(vertices, count);
+
+    // full vertices need no conversion, e.g. the driver copies directly out of a mapped mesh cache
+    if (this->vertex_format == VertexFormat()) {
+        this->VBO.write_buffer_data(vertices, count, GL_STATIC_DRAW);
+        return;
+    }
+    this->VBO.write_buffer_data(this->vertex_format.pack(vertices, count, this->bounds), GL_STATIC_DRAW);
+}
+
+void Mesh::setup_instance_attributes() {
+    // instance transforms, the buffer is attached per draw in draw_instanced
+    for (GLuint i = 0; i < 4; i++) {
+        glVertexAttribFormat(instance_attribute + i, 4, GL_FLOAT, GL_FALSE, i * sizeof(glm::vec4));
+        glVertexAttribBinding(instance_attribute + i, instance_binding);
+        glEnableVertexAttribArray(instance_attribute + i);
+    }
+    glVertexBindingDivisor(instance_binding, 1);
+}
+
+void Mesh::compute_bounds() {
+    this->bounds = BoundingBox();
+    for (const Vertex& vertex : this->vertices) {
+        this->bounds.expand(vertex.position);
+    }
+
+    // centering the sphere on the box is not minimal but is never looser than the box's circumsphere
+    this->bounding_sphere.center = this->bounds.center();
+    this->bounding_sphere.radius = 0.0f;
+    for (const Vertex& vertex : this->vertices) {
+        float distance = glm::length(vertex.position - this->bounding_sphere.center);
+        this->bounding_sphere.radius = std::max(this->bounding_sphere.radius, distance);
+    }
 }
 
 void Mesh::draw(const Shader& shader) const {
+    this->bind_textures(shader);
+    this->set_vertex_bounds(shader);
+
+    // draw mesh
+    this->VAO.bind();
+    glDrawElements(GL_TRIANGLES, this->lods[0].index_count, GL_UNSIGNED_INT, 0);
+    GLState::draw_calls++;
+}
+
+void Mesh::draw_instanced(const Shader& shader, GLuint instance_buffer, GLuint first_instance, GLsizei count,
+                          uint32_t lod) const {
+    this->bind_textures(shader);
+    this->set_vertex_bounds(shader);
+
+    // meshes with fewer levels than asked for draw their coarsest
+    const MeshLod& range = this->lods[std::min<size_t>(lod, this->lods.size() - 1)];
+
+    this->VAO.bind();
+    glBindVertexBuffer(instance_binding, instance_buffer, first_instance * sizeof(glm::mat4), sizeof(glm::mat4));
+    glDrawElementsInstanced(GL_TRIANGLES, range.index_count, GL_UNSIGNED_INT,
+                            reinterpret_cast<const void*>(range.first_index * sizeof(GLuint)), count);
+    GLState::draw_calls++;
+}
+
+void Mesh::bind_textures(const Shader& shader) const {
+    if (this->textures.empty()) {
+        return;
+    }
+    const std::vector<UniformHandle>& locations = this->get_uniforms(shader).samplers;
+    for (size_t i = 0; i < this->textures.size(); i++) {
+        GLuint unit = GLState::bind_texture(GL_TEXTURE_2D, this->textures[i].id);
+        shader.set(locations[i], static_cast<int>(unit));
+    }
+}
+
+const Mesh::ShaderUniforms& Mesh::get_uniforms(const Shader& shader) const {
+    for (const ShaderUniforms& uniforms : this->shader_uniforms) {
+        if (uniforms.program == shader.id) {
+            return uniforms;
+        }
+    }
+
+    ShaderUniforms uniforms;
+    uniforms.program = shader.id;
+    for (const std::string& name : this->sampler_names) {
+        uniforms.samplers.push_back(shader.get_uniform(name));
+    }
+    uniforms.vertex_bounds_min = shader.get_uniform("vertexBoundsMin");
+    uniforms.vertex_bounds_size = shader.get_uniform("vertexBoundsSize");
+    this->shader_uniforms.push_back(std::move(uniforms));
+    return this->shader_uniforms.back();
+}
+
+void Mesh::set_vertex_bounds(const Shader& shader) const {
+    if (this->vertex_format.quantize_positions) {
+        const ShaderUniforms& uniforms = this->get_uniforms(shader);
+        shader.set(uniforms.vertex_bounds_min, this->bounds.min);
+        shader.set(uniforms.vertex_bounds_size, this->bounds.max - this->bounds.min);
+    }
+}
+
+void Mesh::setup_sampler_names() {
     GLuint n_diffuse = 1;
     GLuint n_specular = 1;
     GLuint n_normal = 1;
     GLuint n_height = 1;
 
+    // build the sampler uniform names once here rather than on every draw
+    this->sampler_names.clear();
+    this->shader_uniforms.clear();
     for (size_t i = 0; i < this->textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + this->textures[i].unit);
-
         std::string number;
         std::string name = textures[i].type;
         if (name == "texture_diffuse") {
@@ -53,13 +184,8 @@ void Mesh::draw(const Shader& shader) const {
             number = std::to_string(n_height++);
         }
 
-        shader.set(name + number, this->textures[i].unit);
-        glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
+        this->sampler_names.push_back(name + number);
     }
-
-    // draw mesh
-    this->VAO.bind();
-    glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
 }
 
 MeshData Mesh::generate_cube_mesh() {
@@ -119,7 +245,7 @@ MeshData Mesh::generate_cube_mesh() {
         });
         indices.push_back(i);
     }
-    return {vertices, indices, {}};
+    return {vertices, indices, {}, {}};
 }
 
 MeshData Mesh::generate_plane_mesh() {
@@ -146,5 +272,5 @@ MeshData Mesh::generate_plane_mesh() {
         });
         indices.push_back(i);
     }
-    return {vertices, indices, {}};
+    return {vertices, indices, {}, {}};
 }
\ No newline at end of file
@@ -0,0 +1,323 @@
+#include "meshcache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            this->data = static_cast<const unsigned char*>(mapping);
+            this->size = info.st_size;
+        }
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (this->data) {
+        munmap(const_cast<unsigned char*>(this->data), this->size);
+    }
+}
+
+namespace {
+
+constexpr char magic[4] = {'G', 'E', 'M', 'C'};
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertex_size;
+    uint32_t import_flags;
+    int64_t source_mtime;
+    uint64_t source_size;
+    uint32_t mesh_count;
+    uint32_t texture_count;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint32_t source_path_length; // the source path is stored at the start of the string table
+    uint32_t optimize_flags;     // was padding, so older files read as unoptimized
+    uint32_t lod_count;
+    uint32_t padding;
+};
+
+struct CacheMesh {
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t first_texture;
+    uint32_t texture_count;
+    uint32_t first_lod;
+    uint32_t lod_count;
+    float bounds_min[3];
+    float bounds_max[3];
+    float sphere_center[3];
+    float sphere_radius;
+};
+
+struct CacheTexture {
+    uint32_t type_offset;
+    uint32_t type_length;
+    uint32_t path_offset;
+    uint32_t path_length;
+};
+
+struct CacheLod {
+    uint32_t first_index;
+    uint32_t index_count;
+    float error;
+    uint32_t padding;
+};
+
+uint64_t align(uint64_t offset) {
+    return (offset + 15) & ~uint64_t(15);
+}
+
+} // namespace
+
+std::string MeshCache::get_cache_path(const std::string& source_path) {
+    std::ostringstream name;
+    name << "cache/" << std::hex << std::setw(16) << std::setfill('0')
+         << std::hash<std::string>{}(source_path) << ".mesh";
+    return name.str();
+}
+
+bool MeshCache::make_key(const std::string& source_path, uint32_t import_flags, uint32_t optimize_flags,
+                         MeshCacheKey& key) {
+    std::error_code error;
+    auto mtime = std::filesystem::last_write_time(source_path, error);
+    if (error) {
+        return false;
+    }
+    auto size = std::filesystem::file_size(source_path, error);
+    if (error) {
+        return false;
+    }
+
+    key.source_path = source_path;
+    key.source_mtime = mtime.time_since_epoch().count();
+    key.source_size = size;
+    key.import_flags = import_flags;
+    key.optimize_flags = optimize_flags;
+    return true;
+}
+
+bool MeshCache::read(const MappedFile& file, const MeshCacheKey& key, std::vector<MeshView>& meshes) {
+    if (!file.is_open() || file.size < sizeof(CacheHeader)) {
+        return false;
+    }
+
+    CacheHeader header;
+    std::memcpy(&header, file.data, sizeof(header));
+
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0
+        || header.version != MeshCache::version
+        || header.vertex_size != sizeof(Vertex)
+        || header.import_flags != key.import_flags
+        || header.optimize_flags != key.optimize_flags
+        || header.source_mtime != key.source_mtime
+        || header.source_size != key.source_size) {
+        return false;
+    }
+
+    // every range read below has to lie inside the file, a truncated write must not crash the load
+    auto in_file = [&file](uint64_t offset, uint64_t size) {
+        return offset <= file.size && size <= file.size - offset;
+    };
+
+    uint64_t meshes_offset = align(sizeof(CacheHeader));
+    uint64_t textures_offset = align(meshes_offset + header.mesh_count * sizeof(CacheMesh));
+    uint64_t lods_offset = align(textures_offset + header.texture_count * sizeof(CacheTexture));
+    if (!in_file(meshes_offset, uint64_t(header.mesh_count) * sizeof(CacheMesh))
+        || !in_file(textures_offset, uint64_t(header.texture_count) * sizeof(CacheTexture))
+        || !in_file(lods_offset, uint64_t(header.lod_count) * sizeof(CacheLod))
+        || !in_file(header.strings_offset, header.strings_size)
+        || header.source_path_length > header.strings_size) {
+        return false;
+    }
+
+    const char* strings = reinterpret_cast<const char*>(file.data + header.strings_offset);
+    if (key.source_path.compare(0, std::string::npos, strings, header.source_path_length) != 0) {
+        return false;
+    }
+
+    auto get_string = [&](uint32_t offset, uint32_t length, std::string& result) {
+        if (uint64_t(offset) + length > header.strings_size) {
+            return false;
+        }
+        result.assign(strings + offset, length);
+        return true;
+    };
+
+    const CacheMesh* records = reinterpret_cast<const CacheMesh*>(file.data + meshes_offset);
+    const CacheTexture* texture_records = reinterpret_cast<const CacheTexture*>(file.data + textures_offset);
+    const CacheLod* lod_records = reinterpret_cast<const CacheLod*>(file.data + lods_offset);
+
+    meshes.clear();
+    meshes.reserve(header.mesh_count);
+
+    for (uint32_t i = 0; i < header.mesh_count; i++) {
+        const CacheMesh& record = records[i];
+        if (!in_file(record.vertex_offset, uint64_t(record.vertex_count) * sizeof(Vertex))
+            || !in_file(record.index_offset, uint64_t(record.index_count) * sizeof(GLuint))
+            || uint64_t(record.first_texture) + record.texture_count > header.texture_count
+            || uint64_t(record.first_lod) + record.lod_count > header.lod_count) {
+            return false;
+        }
+
+        MeshView view;
+        view.vertices = reinterpret_cast<const Vertex*>(file.data + record.vertex_offset);
+        view.vertex_count = record.vertex_count;
+        view.indices = reinterpret_cast<const GLuint*>(file.data + record.index_offset);
+        view.index_count = record.index_count;
+        view.bounds.min = glm::vec3(record.bounds_min[0], record.bounds_min[1], record.bounds_min[2]);
+        view.bounds.max = glm::vec3(record.bounds_max[0], record.bounds_max[1], record.bounds_max[2]);
+        view.bounding_sphere.center = glm::vec3(record.sphere_center[0], record.sphere_center[1], record.sphere_center[2]);
+        view.bounding_sphere.radius = record.sphere_radius;
+
+        for (uint32_t j = 0; j < record.texture_count; j++) {
+            const CacheTexture& texture = texture_records[record.first_texture + j];
+            TextureRef ref;
+            if (!get_string(texture.type_offset, texture.type_length, ref.type)
+                || !get_string(texture.path_offset, texture.path_length, ref.path)) {
+                return false;
+            }
+            view.textures.push_back(std::move(ref));
+        }
+
+        for (uint32_t j = 0; j < record.lod_count; j++) {
+            const CacheLod& lod = lod_records[record.first_lod + j];
+            if (uint64_t(lod.first_index) + lod.index_count > record.index_count) {
+                return false;
+            }
+            view.lods.push_back({lod.first_index, lod.index_count, lod.error});
+        }
+
+        meshes.push_back(std::move(view));
+    }
+
+    return true;
+}
+
+void MeshCache::write(const std::string& cache_path, const MeshCacheKey& key, const std::vector<Mesh>& meshes) {
+    CacheHeader header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = MeshCache::version;
+    header.vertex_size = sizeof(Vertex);
+    header.import_flags = key.import_flags;
+    header.optimize_flags = key.optimize_flags;
+    header.source_mtime = key.source_mtime;
+    header.source_size = key.source_size;
+    header.mesh_count = meshes.size();
+    header.source_path_length = key.source_path.size();
+
+    std::string strings = key.source_path;
+    std::vector<CacheMesh> records;
+    std::vector<CacheTexture> texture_records;
+    std::vector<CacheLod> lod_records;
+
+    auto add_string = [&strings](const std::string& value, uint32_t& offset, uint32_t& length) {
+        offset = strings.size();
+        length = value.size();
+        strings += value;
+    };
+
+    for (const Mesh& mesh : meshes) {
+        CacheMesh record = {};
+        record.vertex_count = mesh.vertices.size();
+        record.index_count = mesh.indices.size();
+        record.first_texture = texture_records.size();
+        record.texture_count = mesh.textures.size();
+        record.first_lod = lod_records.size();
+        record.lod_count = mesh.lods.size();
+        for (int i = 0; i < 3; i++) {
+            record.bounds_min[i] = mesh.bounds.min[i];
+            record.bounds_max[i] = mesh.bounds.max[i];
+            record.sphere_center[i] = mesh.bounding_sphere.center[i];
+        }
+        record.sphere_radius = mesh.bounding_sphere.radius;
+
+        for (const Texture& texture : mesh.textures) {
+            CacheTexture texture_record;
+            add_string(texture.type, texture_record.type_offset, texture_record.type_length);
+            add_string(texture.path, texture_record.path_offset, texture_record.path_length);
+            texture_records.push_back(texture_record);
+        }
+        for (const MeshLod& lod : mesh.lods) {
+            lod_records.push_back({lod.first_index, lod.index_count, lod.error, 0});
+        }
+        records.push_back(record);
+    }
+    header.texture_count = texture_records.size();
+    header.lod_count = lod_records.size();
+
+    // lay out the sections, then fill in the data offsets of every mesh
+    uint64_t meshes_offset = align(sizeof(CacheHeader));
+    uint64_t textures_offset = align(meshes_offset + records.size() * sizeof(CacheMesh));
+    uint64_t lods_offset = align(textures_offset + texture_records.size() * sizeof(CacheTexture));
+    header.strings_offset = align(lods_offset + lod_records.size() * sizeof(CacheLod));
+    header.strings_size = strings.size();
+
+    uint64_t offset = align(header.strings_offset + strings.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        records[i].vertex_offset = offset;
+        offset = align(offset + meshes[i].vertices.size() * sizeof(Vertex));
+        records[i].index_offset = offset;
+        offset = align(offset + meshes[i].indices.size() * sizeof(GLuint));
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path(), error);
+
+    // written to a temporary file first so an interrupted write never leaves a partial cache behind
+    std::string temporary_path = cache_path + ".tmp";
+    std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to write mesh cache " << cache_path << std::endl;
+        return;
+    }
+
+    auto write_at = [&out](uint64_t position, const void* data, size_t size) {
+        // pad up to the section's aligned offset
+        static const char zeros[16] = {};
+        out.write(zeros, position - static_cast<uint64_t>(out.tellp()));
+        out.write(static_cast<const char*>(data), size);
+    };
+
+    write_at(0, &header, sizeof(header));
+    write_at(meshes_offset, records.data(), records.size() * sizeof(CacheMesh));
+    write_at(textures_offset, texture_records.data(), texture_records.size() * sizeof(CacheTexture));
+    write_at(lods_offset, lod_records.data(), lod_records.size() * sizeof(CacheLod));
+    write_at(header.strings_offset, strings.data(), strings.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        write_at(records[i].vertex_offset, meshes[i].vertices.data(), meshes[i].vertices.size() * sizeof(Vertex));
+        write_at(records[i].index_offset, meshes[i].indices.data(), meshes[i].indices.size() * sizeof(GLuint));
+    }
+    out.close();
+
+    if (out) {
+        std::filesystem::rename(temporary_path, cache_path, error);
+    }
+    if (!out || error) {
+        std::cerr << "Failed to write mesh cache " << cache_path << std::endl;
+        std::filesystem::remove(temporary_path, error);
+    }
+}
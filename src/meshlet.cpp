@@ -0,0 +1,179 @@
+#include "meshlet.h"
+
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+std::vector<Meshlet> MeshletBuilder::build(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices) {
+    size_t triangle_count = indices.size() / 3;
+    std::vector<Meshlet> meshlets;
+    if (triangle_count == 0) {
+        return meshlets;
+    }
+
+    // triangles using each vertex, stored contiguously per vertex
+    std::vector<uint32_t> offsets(vertices.size() + 1, 0);
+    for (GLuint index : indices) {
+        offsets[index + 1]++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(vertices.size(), 0);
+    for (size_t t = 0; t < triangle_count; t++) {
+        for (int k = 0; k < 3; k++) {
+            GLuint v = indices[t * 3 + k];
+            adjacency[offsets[v] + fill[v]++] = t;
+        }
+    }
+
+    std::vector<glm::vec3> centroids(triangle_count);
+    for (size_t t = 0; t < triangle_count; t++) {
+        centroids[t] = (vertices[indices[t * 3]].position + vertices[indices[t * 3 + 1]].position
+            + vertices[indices[t * 3 + 2]].position) / 3.0f;
+    }
+
+    constexpr uint32_t unassigned = 0xFFFFFFFF;
+    std::vector<uint32_t> vertex_meshlet(vertices.size(), unassigned); // last meshlet each vertex joined
+    std::vector<bool> used(triangle_count, false);
+    std::vector<GLuint> meshlet_vertices;
+    meshlet_vertices.reserve(max_vertices);
+    std::vector<uint32_t> candidates; // unused triangles sharing a vertex with the meshlet, may repeat
+
+    std::vector<GLuint> result;
+    result.reserve(indices.size());
+    size_t cursor = 0;
+
+    while (result.size() < indices.size()) {
+        uint32_t meshlet_id = meshlets.size();
+        uint32_t first_index = result.size();
+        uint32_t meshlet_triangles = 0;
+        glm::vec3 centroid_sum = glm::vec3(0.0f);
+        meshlet_vertices.clear();
+        candidates.clear();
+
+        auto new_vertex_count = [&](size_t t) {
+            uint32_t count = 0;
+            for (int k = 0; k < 3; k++) {
+                count += vertex_meshlet[indices[t * 3 + k]] != meshlet_id;
+            }
+            return count;
+        };
+
+        auto add_triangle = [&](size_t t) {
+            used[t] = true;
+            for (int k = 0; k < 3; k++) {
+                GLuint v = indices[t * 3 + k];
+                result.push_back(v);
+                if (vertex_meshlet[v] != meshlet_id) {
+                    vertex_meshlet[v] = meshlet_id;
+                    meshlet_vertices.push_back(v);
+                    for (uint32_t j = offsets[v]; j < offsets[v + 1]; j++) {
+                        if (!used[adjacency[j]]) {
+                            candidates.push_back(adjacency[j]);
+                        }
+                    }
+                }
+            }
+            centroid_sum += centroids[t];
+            meshlet_triangles++;
+        };
+
+        // seed with the next unused triangle in the input order, which is cache optimized if anything
+        while (used[cursor]) {
+            cursor++;
+        }
+        add_triangle(cursor);
+
+        while (meshlet_triangles < max_triangles) {
+            glm::vec3 center = centroid_sum / float(meshlet_triangles);
+            int64_t best = -1;
+            uint32_t best_new_vertices = 4;
+            float best_distance = std::numeric_limits<float>::max();
+
+            // fewest new vertices first, then closest to the center
+            for (size_t j = 0; j < candidates.size();) {
+                uint32_t t = candidates[j];
+                if (used[t]) {
+                    candidates[j] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                j++;
+
+                uint32_t new_vertices = new_vertex_count(t);
+                if (meshlet_vertices.size() + new_vertices > max_vertices) {
+                    continue;
+                }
+
+                glm::vec3 offset = centroids[t] - center;
+                float distance = glm::dot(offset, offset);
+                if (new_vertices < best_new_vertices
+                    || (new_vertices == best_new_vertices && distance < best_distance)) {
+                    best = t;
+                    best_new_vertices = new_vertices;
+                    best_distance = distance;
+                }
+            }
+
+            if (best < 0) {
+                break;
+            }
+            add_triangle(best);
+        }
+
+        meshlets.push_back(compute_bounds(vertices, result.data(), first_index, meshlet_triangles * 3));
+    }
+
+    indices = std::move(result);
+    return meshlets;
+}
+
+Meshlet MeshletBuilder::compute_bounds(const std::vector<Vertex>& vertices, const GLuint* indices,
+                                       uint32_t first_index, uint32_t index_count) {
+    Meshlet meshlet;
+    meshlet.first_index = first_index;
+    meshlet.index_count = index_count;
+
+    // centering the sphere on the box is not minimal but is never looser than the box's circumsphere
+    BoundingBox box;
+    for (uint32_t i = first_index; i < first_index + index_count; i++) {
+        box.expand(vertices[indices[i]].position);
+    }
+    meshlet.sphere.center = box.center();
+    meshlet.sphere.radius = 0.0f;
+    for (uint32_t i = first_index; i < first_index + index_count; i++) {
+        float distance = glm::length(vertices[indices[i]].position - meshlet.sphere.center);
+        meshlet.sphere.radius = std::max(meshlet.sphere.radius, distance);
+    }
+
+    // the cone's axis is the average face normal and its width the normal furthest from it
+    std::vector<glm::vec3> normals;
+    normals.reserve(index_count / 3);
+    glm::vec3 normal_sum = glm::vec3(0.0f);
+    for (uint32_t i = first_index; i < first_index + index_count; i += 3) {
+        const glm::vec3& a = vertices[indices[i]].position;
+        const glm::vec3& b = vertices[indices[i + 1]].position;
+        const glm::vec3& c = vertices[indices[i + 2]].position;
+
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length > 0.0f) {
+            normals.push_back(normal / length);
+            normal_sum += normals.back();
+        }
+    }
+
+    float axis_length = glm::length(normal_sum);
+    meshlet.cone_axis = axis_length > 0.0f ? normal_sum / axis_length : glm::vec3(0.0f, 0.0f, 1.0f);
+
+    float min_dot = axis_length > 0.0f ? 1.0f : -1.0f;
+    for (const glm::vec3& normal : normals) {
+        min_dot = std::min(min_dot, glm::dot(normal, meshlet.cone_axis));
+    }
+
+    // a cone of 90 degrees or more always has a triangle facing the camera
+    meshlet.cone_cutoff = min_dot <= 0.0f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+    return meshlet;
+}
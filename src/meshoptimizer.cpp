@@ -0,0 +1,359 @@
+#include "meshoptimizer.h"
+#include "meshsimplifier.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+namespace {
+
+// scoring constants from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+constexpr int forsyth_cache_size = 32;
+constexpr float cache_decay_power = 1.5f;
+constexpr float last_triangle_score = 0.75f;
+constexpr float valence_boost_scale = 2.0f;
+constexpr float valence_boost_power = 0.5f;
+
+constexpr uint32_t max_valence_score = 32; // valences from here on are scored without the table
+
+struct ScoreTables {
+    float cache[forsyth_cache_size];
+    float valence[max_valence_score];
+
+    ScoreTables() {
+        for (int i = 0; i < forsyth_cache_size; i++) {
+            if (i < 3) {
+                // fixed score for the last triangle's vertices so strips are not favoured over fans
+                this->cache[i] = last_triangle_score;
+            } else {
+                float scale = 1.0f / (forsyth_cache_size - 3);
+                this->cache[i] = std::pow(1.0f - (i - 3) * scale, cache_decay_power);
+            }
+        }
+
+        // vertices with few triangles left are finished off first so they can leave the cache
+        this->valence[0] = 0.0f;
+        for (uint32_t i = 1; i < max_valence_score; i++) {
+            this->valence[i] = valence_boost_scale * std::pow(float(i), -valence_boost_power);
+        }
+    }
+};
+
+float vertex_score(const ScoreTables& tables, int cache_position, uint32_t remaining_triangles) {
+    if (remaining_triangles == 0) {
+        return -1.0f; // nothing left to draw with it, never worth keeping
+    }
+
+    float score = cache_position >= 0 ? tables.cache[cache_position] : 0.0f;
+    if (remaining_triangles < max_valence_score) {
+        return score + tables.valence[remaining_triangles];
+    }
+    return score + valence_boost_scale * std::pow(float(remaining_triangles), -valence_boost_power);
+}
+
+// FIFO post-transform cache, a vertex stays resident until size later misses have pushed it out
+class FifoCache {
+public:
+    FifoCache(size_t vertex_count, uint32_t size) : stamps(vertex_count, 0), size(size) {}
+
+    // returns how many of the triangle's vertices missed
+    uint32_t add(const GLuint* triangle) {
+        uint32_t triangle_misses = 0;
+        for (int i = 0; i < 3; i++) {
+            uint64_t& stamp = this->stamps[triangle[i]];
+            if (stamp == 0 || this->misses - stamp >= this->size) {
+                this->misses++;
+                stamp = this->misses;
+                triangle_misses++;
+            }
+        }
+        return triangle_misses;
+    }
+
+    // evicts every vertex without touching the stamps
+    void reset() { this->misses += this->size; }
+
+private:
+    std::vector<uint64_t> stamps; // miss count at which each vertex was loaded, 0 if never
+    uint64_t misses = 0;
+    uint32_t size;
+};
+
+} // namespace
+
+void MeshOptimizer::optimize(MeshData& mesh, uint32_t flags) {
+    if (flags & MeshOptimizer::GenerateLods) {
+        mesh.lods = MeshSimplifier::build_lods(mesh.vertices, mesh.indices);
+    }
+
+    // every level is drawn on its own, so each is ordered for the cache separately
+    std::vector<MeshLod> ranges = mesh.lods;
+    if (ranges.empty()) {
+        ranges.push_back({0, static_cast<uint32_t>(mesh.indices.size()), 0.0f});
+    }
+    if (flags & (MeshOptimizer::VertexCache | MeshOptimizer::Overdraw)) {
+        for (const MeshLod& range : ranges) {
+            auto begin = mesh.indices.begin() + range.first_index;
+            std::vector<GLuint> indices(begin, begin + range.index_count);
+            if (flags & MeshOptimizer::VertexCache) {
+                optimize_vertex_cache(indices, mesh.vertices.size());
+            }
+            if (flags & MeshOptimizer::Overdraw) {
+                optimize_overdraw(indices, mesh.vertices);
+            }
+            std::copy(indices.begin(), indices.end(), begin);
+        }
+    }
+
+    // level 0 comes first in the indices, so its vertices get the front of the buffer
+    if (flags & MeshOptimizer::VertexFetch) {
+        optimize_vertex_fetch(mesh.vertices, mesh.indices);
+    }
+}
+
+void MeshOptimizer::optimize_vertex_cache(std::vector<GLuint>& indices, size_t vertex_count) {
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // triangles using each vertex, stored contiguously per vertex. The first remaining[v] entries of a
+    // vertex's range are the triangles it still has to be drawn with.
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (GLuint index : indices) {
+        offsets[index + 1]++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> remaining(vertex_count, 0);
+    for (size_t t = 0; t < triangle_count; t++) {
+        for (int k = 0; k < 3; k++) {
+            GLuint v = indices[t * 3 + k];
+            adjacency[offsets[v] + remaining[v]++] = t;
+        }
+    }
+
+    static const ScoreTables tables;
+    std::vector<int> cache_positions(vertex_count, -1);
+    std::vector<float> vertex_scores(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        vertex_scores[v] = vertex_score(tables, -1, remaining[v]);
+    }
+
+    std::vector<float> triangle_scores(triangle_count);
+    for (size_t t = 0; t < triangle_count; t++) {
+        triangle_scores[t] = vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]]
+            + vertex_scores[indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<GLuint> result;
+    result.reserve(indices.size());
+
+    std::vector<GLuint> cache, next_cache;
+    cache.reserve(forsyth_cache_size + 3);
+    next_cache.reserve(forsyth_cache_size + 3);
+
+    size_t input_cursor = 0;
+    int64_t best = -1;
+
+    while (result.size() < indices.size()) {
+        if (best < 0) {
+            // nothing in the cache has triangles left, continue with the next one in input order
+            while (emitted[input_cursor]) {
+                input_cursor++;
+            }
+            best = input_cursor;
+        }
+
+        const GLuint* triangle = &indices[best * 3];
+        emitted[best] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        for (int k = 0; k < 3; k++) {
+            GLuint v = triangle[k];
+            uint32_t* begin = &adjacency[offsets[v]];
+            uint32_t* end = begin + remaining[v];
+            std::iter_swap(std::find(begin, end, best), end - 1);
+            remaining[v]--;
+        }
+
+        // the triangle's vertices move to the front, everything past the cache size is evicted
+        next_cache.assign(triangle, triangle + 3);
+        for (GLuint v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                next_cache.push_back(v);
+            }
+        }
+
+        for (size_t i = 0; i < next_cache.size(); i++) {
+            GLuint v = next_cache[i];
+            cache_positions[v] = i < forsyth_cache_size ? static_cast<int>(i) : -1;
+            vertex_scores[v] = vertex_score(tables, cache_positions[v], remaining[v]);
+        }
+
+        // rescore the triangles whose vertices changed and pick the best one still in reach of the cache
+        best = -1;
+        float best_score = -1.0f;
+        for (size_t i = 0; i < next_cache.size(); i++) {
+            GLuint v = next_cache[i];
+            for (uint32_t j = offsets[v]; j < offsets[v] + remaining[v]; j++) {
+                uint32_t t = adjacency[j];
+                triangle_scores[t] = vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]]
+                    + vertex_scores[indices[t * 3 + 2]];
+
+                if (i < forsyth_cache_size && triangle_scores[t] > best_score) {
+                    best_score = triangle_scores[t];
+                    best = t;
+                }
+            }
+        }
+
+        next_cache.resize(std::min<size_t>(next_cache.size(), forsyth_cache_size));
+        std::swap(cache, next_cache);
+    }
+
+    indices = std::move(result);
+}
+
+void MeshOptimizer::optimize_overdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices,
+                                      float threshold) {
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count < 2) {
+        return;
+    }
+
+    constexpr uint32_t cache_size = 16;
+
+    // hard boundaries, where all three vertices of a triangle miss so nothing is lost by cutting there
+    std::vector<size_t> hard_boundaries;
+    FifoCache cache(vertices.size(), cache_size);
+    for (size_t t = 0; t < triangle_count; t++) {
+        if (cache.add(&indices[t * 3]) == 3) {
+            hard_boundaries.push_back(t);
+        }
+    }
+    hard_boundaries.push_back(triangle_count);
+
+    // soft boundaries, a cluster ends once its own ACMR, restarting from a cold cache, is close enough to
+    // that of the hard cluster it is part of
+    std::vector<size_t> clusters;
+    for (size_t i = 0; i + 1 < hard_boundaries.size(); i++) {
+        size_t begin = hard_boundaries[i];
+        size_t end = hard_boundaries[i + 1];
+
+        cache.reset();
+        uint32_t cluster_misses = 0;
+        for (size_t t = begin; t < end; t++) {
+            cluster_misses += cache.add(&indices[t * 3]);
+        }
+        float cluster_acmr = float(cluster_misses) / (end - begin);
+
+        cache.reset();
+        clusters.push_back(begin);
+        uint32_t misses = 0;
+        size_t start = begin;
+        for (size_t t = begin; t < end; t++) {
+            misses += cache.add(&indices[t * 3]);
+
+            if (t + 1 < end && float(misses) / (t + 1 - start) <= cluster_acmr * threshold) {
+                cache.reset();
+                clusters.push_back(t + 1);
+                misses = 0;
+                start = t + 1;
+            }
+        }
+    }
+    clusters.push_back(triangle_count);
+
+    // area-weighted centroid and normal of every cluster and of the whole mesh
+    size_t cluster_count = clusters.size() - 1;
+    std::vector<glm::vec3> centroids(cluster_count, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(cluster_count, glm::vec3(0.0f));
+    std::vector<float> areas(cluster_count, 0.0f);
+    glm::vec3 mesh_centroid = glm::vec3(0.0f);
+    float mesh_area = 0.0f;
+
+    for (size_t c = 0; c < cluster_count; c++) {
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const glm::vec3& a = vertices[indices[t * 3]].position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3& d = vertices[indices[t * 3 + 2]].position;
+
+            glm::vec3 normal = glm::cross(b - a, d - a); // length is twice the area
+            float area = glm::length(normal);
+            centroids[c] += (a + b + d) * (area / 3.0f);
+            normals[c] += normal;
+            areas[c] += area;
+        }
+        mesh_centroid += centroids[c];
+        mesh_area += areas[c];
+    }
+    mesh_centroid = mesh_area > 0.0f ? mesh_centroid / mesh_area : mesh_centroid;
+
+    // clusters far out along their own normal are likely to occlude the rest, so they are drawn first
+    std::vector<float> sort_keys(cluster_count);
+    for (size_t c = 0; c < cluster_count; c++) {
+        glm::vec3 centroid = areas[c] > 0.0f ? centroids[c] / areas[c] : centroids[c];
+        float normal_length = glm::length(normals[c]);
+        glm::vec3 normal = normal_length > 0.0f ? normals[c] / normal_length : normals[c];
+        sort_keys[c] = glm::dot(centroid - mesh_centroid, normal);
+    }
+
+    std::vector<size_t> order(cluster_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sort_keys](size_t a, size_t b) {
+        return sort_keys[a] > sort_keys[b];
+    });
+
+    std::vector<GLuint> result;
+    result.reserve(indices.size());
+    for (size_t c : order) {
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+    indices = std::move(result);
+}
+
+void MeshOptimizer::optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices) {
+    constexpr GLuint unused = 0xFFFFFFFF;
+
+    std::vector<GLuint> remap(vertices.size(), unused);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+
+    for (GLuint& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = result.size();
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(result);
+}
+
+VertexCacheStats MeshOptimizer::analyze_vertex_cache(const std::vector<GLuint>& indices, size_t vertex_count,
+                                                     uint32_t cache_size) {
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return {0.0f, 0.0f};
+    }
+
+    FifoCache cache(vertex_count, cache_size);
+    uint64_t misses = 0;
+    for (size_t t = 0; t < triangle_count; t++) {
+        misses += cache.add(&indices[t * 3]);
+    }
+
+    std::vector<bool> referenced(vertex_count, false);
+    size_t referenced_count = 0;
+    for (GLuint index : indices) {
+        if (!referenced[index]) {
+            referenced[index] = true;
+            referenced_count++;
+        }
+    }
+
+    return {float(misses) / triangle_count, float(misses) / referenced_count};
+}
@@ -0,0 +1,296 @@
+#include "meshsimplifier.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cmath>
+
+namespace {
+
+// sum of squared distances to a set of planes, weighted by the area of the triangle each plane came from
+struct Quadric {
+    double a2 = 0, b2 = 0, c2 = 0, ab = 0, ac = 0, bc = 0, ad = 0, bd = 0, cd = 0, d2 = 0;
+    double weight = 0;
+
+    void add_plane(const glm::vec3& normal, float distance, double area) {
+        double a = normal.x, b = normal.y, c = normal.z, d = distance;
+        this->a2 += a * a * area;
+        this->b2 += b * b * area;
+        this->c2 += c * c * area;
+        this->ab += a * b * area;
+        this->ac += a * c * area;
+        this->bc += b * c * area;
+        this->ad += a * d * area;
+        this->bd += b * d * area;
+        this->cd += c * d * area;
+        this->d2 += d * d * area;
+        this->weight += area;
+    }
+
+    void add(const Quadric& other) {
+        this->a2 += other.a2;
+        this->b2 += other.b2;
+        this->c2 += other.c2;
+        this->ab += other.ab;
+        this->ac += other.ac;
+        this->bc += other.bc;
+        this->ad += other.ad;
+        this->bd += other.bd;
+        this->cd += other.cd;
+        this->d2 += other.d2;
+        this->weight += other.weight;
+    }
+
+    // mean squared distance of point to the planes
+    double error(const glm::vec3& point) const {
+        double x = point.x, y = point.y, z = point.z;
+        double sum = this->a2 * x * x + this->b2 * y * y + this->c2 * z * z
+            + 2.0 * (this->ab * x * y + this->ac * x * z + this->bc * y * z)
+            + 2.0 * (this->ad * x + this->bd * y + this->cd * z) + this->d2;
+        return this->weight > 0.0 ? std::max(sum / this->weight, 0.0) : 0.0;
+    }
+};
+
+struct Collapse {
+    GLuint from;
+    GLuint to;
+    double cost;
+};
+
+uint64_t edge_key(GLuint a, GLuint b) {
+    return a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+}
+
+} // namespace
+
+std::vector<GLuint> MeshSimplifier::simplify(const std::vector<Vertex>& vertices, const GLuint* indices,
+                                             size_t index_count, size_t target_index_count, float max_error,
+                                             float& error) {
+    std::vector<GLuint> result(indices, indices + index_count);
+    error = 0.0f;
+    size_t vertex_count = vertices.size();
+
+    // weld vertices sharing a position so seams do not look like borders
+    std::vector<GLuint> positions(vertex_count);
+    std::unordered_map<uint64_t, std::vector<GLuint>> position_buckets;
+    for (GLuint v = 0; v < vertex_count; v++) {
+        const glm::vec3& p = vertices[v].position;
+        uint32_t bits[3];
+        std::memcpy(bits, &p, sizeof(bits));
+        uint64_t hash = (uint64_t(bits[0]) * 73856093u) ^ (uint64_t(bits[1]) * 19349663u) ^ (uint64_t(bits[2]) * 83492791u);
+
+        std::vector<GLuint>& bucket = position_buckets[hash];
+        auto same = std::find_if(bucket.begin(), bucket.end(), [&](GLuint other) {
+            return vertices[other].position == p;
+        });
+        if (same == bucket.end()) {
+            bucket.push_back(v);
+            positions[v] = v;
+        } else {
+            positions[v] = *same;
+        }
+    }
+
+    // lock seams, and borders and non-manifold edges of the welded surface
+    std::vector<bool> locked(vertex_count, false);
+    std::vector<GLuint> first_vertex(vertex_count, 0xFFFFFFFF); // first referenced vertex at each position
+    for (GLuint v : result) {
+        GLuint p = positions[v];
+        if (first_vertex[p] == 0xFFFFFFFF) {
+            first_vertex[p] = v;
+        } else if (first_vertex[p] != v) {
+            locked[p] = true;
+        }
+    }
+
+    std::unordered_map<uint64_t, uint32_t> edge_counts;
+    for (size_t i = 0; i < result.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            edge_counts[edge_key(positions[result[i + k]], positions[result[i + (k + 1) % 3]])]++;
+        }
+    }
+    for (const auto& [key, count] : edge_counts) {
+        if (count != 2) {
+            locked[key >> 32] = true;
+            locked[key & 0xFFFFFFFF] = true;
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertex_count);
+    for (size_t i = 0; i < result.size(); i += 3) {
+        const glm::vec3& a = vertices[result[i]].position;
+        const glm::vec3& b = vertices[result[i + 1]].position;
+        const glm::vec3& c = vertices[result[i + 2]].position;
+
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length == 0.0f) {
+            continue;
+        }
+        normal = normal / length;
+        for (int k = 0; k < 3; k++) {
+            quadrics[positions[result[i + k]]].add_plane(normal, -glm::dot(normal, a), length * 0.5f);
+        }
+    }
+
+    double max_cost = double(max_error) * max_error;
+    double applied_cost = 0.0;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> offsets(vertex_count + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<bool> touched(vertex_count);
+    std::vector<GLuint> remap(vertex_count);
+
+    // every pass collapses a set of edges whose neighbourhoods do not overlap, so each one can be checked
+    // against the mesh as it was at the start of the pass
+    while (result.size() > target_index_count) {
+        size_t triangle_count = result.size() / 3;
+
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (GLuint v : result) {
+            offsets[v + 1]++;
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        adjacency.resize(result.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangle_count; t++) {
+            for (int k = 0; k < 3; k++) {
+                adjacency[fill[result[t * 3 + k]]++] = t;
+            }
+        }
+
+        // interior edges are shared by two triangles in opposite directions, so each is visited once, and only
+        // the cheaper of its two directions is kept
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                GLuint a = result[i + k];
+                GLuint b = result[i + (k + 1) % 3];
+                if (a > b) {
+                    continue;
+                }
+
+                Quadric quadric = quadrics[positions[a]];
+                quadric.add(quadrics[positions[b]]);
+                Collapse best = {a, b, max_cost};
+                bool found = false;
+                for (auto [from, to] : {std::pair(a, b), std::pair(b, a)}) {
+                    double cost = quadric.error(vertices[to].position);
+                    if (!locked[positions[from]] && cost <= best.cost) {
+                        best = {from, to, cost};
+                        found = true;
+                    }
+                }
+                if (found) {
+                    collapses.push_back(best);
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost;
+        });
+
+        // each collapse removes about two triangles, do not overshoot the target by much
+        size_t collapses_needed = (result.size() - target_index_count) / 6 + 1;
+        size_t applied = 0;
+        std::fill(touched.begin(), touched.end(), false);
+        std::iota(remap.begin(), remap.end(), 0);
+
+        for (const Collapse& collapse : collapses) {
+            if (applied >= collapses_needed) {
+                break;
+            }
+
+            // the ring around from must be untouched, and no remaining triangle may flip
+            bool valid = true;
+            for (uint32_t j = offsets[collapse.from]; j < offsets[collapse.from + 1] && valid; j++) {
+                const GLuint* triangle = &result[adjacency[j] * 3];
+                bool collapses_away = false;
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; k++) {
+                    valid &= !touched[positions[triangle[k]]];
+                    collapses_away |= triangle[k] == collapse.to;
+                    before[k] = vertices[triangle[k]].position;
+                    after[k] = triangle[k] == collapse.from ? vertices[collapse.to].position : before[k];
+                }
+                if (!valid || collapses_away) {
+                    continue;
+                }
+
+                // turning a triangle by more than about 75 degrees at once is as good as flipping it, a few of
+                // those in a row would turn it over
+                glm::vec3 normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+                valid &= glm::dot(normal_before, normal_after)
+                    > 0.25f * glm::length(normal_before) * glm::length(normal_after);
+            }
+            if (!valid) {
+                continue;
+            }
+
+            for (uint32_t j = offsets[collapse.from]; j < offsets[collapse.from + 1]; j++) {
+                const GLuint* triangle = &result[adjacency[j] * 3];
+                for (int k = 0; k < 3; k++) {
+                    touched[positions[triangle[k]]] = true;
+                }
+            }
+            remap[collapse.from] = collapse.to;
+            quadrics[positions[collapse.to]].add(quadrics[positions[collapse.from]]);
+            applied_cost = std::max(applied_cost, collapse.cost);
+            applied++;
+        }
+
+        if (applied == 0) {
+            break;
+        }
+
+        // drop the triangles that lost an edge
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            GLuint a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (positions[a] != positions[b] && positions[b] != positions[c] && positions[a] != positions[c]) {
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+        }
+        result.resize(write);
+    }
+
+    error = static_cast<float>(std::sqrt(applied_cost));
+    return result;
+}
+
+std::vector<MeshLod> MeshSimplifier::build_lods(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices,
+                                                uint32_t max_lods) {
+    std::vector<MeshLod> lods = {{0, static_cast<uint32_t>(indices.size()), 0.0f}};
+
+    BoundingBox bounds;
+    for (const Vertex& vertex : vertices) {
+        bounds.expand(vertex.position);
+    }
+    // past this the coarsest levels stop resembling the mesh at any distance worth drawing it
+    float error_budget = 0.1f * glm::length(bounds.max - bounds.min);
+
+    // each level is simplified from the one before, so its error is the sum of the errors so far
+    std::vector<GLuint> source = indices;
+    float lod_error = 0.0f;
+
+    for (uint32_t level = 1; level < max_lods && lod_error < error_budget; level++) {
+        size_t target_index_count = source.size() / 6 * 3;
+        float pass_error;
+        std::vector<GLuint> lod = MeshSimplifier::simplify(vertices, source.data(), source.size(), target_index_count,
+                                                           error_budget - lod_error, pass_error);
+        if (lod.empty() || lod.size() > source.size() * 85 / 100) {
+            break;
+        }
+
+        lod_error += pass_error;
+        lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lod.size()), lod_error});
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        source = std::move(lod);
+    }
+
+    return lods;
+}
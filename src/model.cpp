@@ -1,4 +1,5 @@
 #include "model.h"
+#include "texturecache.h"
 
 void Model::draw(const Shader& shader) const {
     for (size_t i = 0; i < this->meshes.size(); i++) {
@@ -6,10 +7,65 @@ void Model::draw(const Shader& shader) const {
     }
 }
 
+void Model::draw_instanced(const Shader& shader, GLuint instance_buffer, GLuint first_instance, GLsizei count,
+                           uint32_t lod) const {
+    for (size_t i = 0; i < this->meshes.size(); i++) {
+        this->meshes[i].draw_instanced(shader, instance_buffer, first_instance, count, lod);
+    }
+}
+
+uint32_t Model::select_lod(float error_scale, float max_error_pixels) const {
+    // errors grow with the level, so stop at the first one that would be visible
+    uint32_t lod = 0;
+    while (lod + 1 < this->lod_errors.size() && this->lod_errors[lod + 1] * error_scale <= max_error_pixels) {
+        lod++;
+    }
+    return lod;
+}
+
+void Model::add_lod_errors(const Mesh& mesh) {
+    if (this->lod_errors.size() < mesh.lods.size()) {
+        this->lod_errors.resize(mesh.lods.size(), 0.0f);
+    }
+    // a mesh with fewer levels keeps drawing its coarsest, so its error counts for every level after it
+    for (size_t i = 0; i < this->lod_errors.size(); i++) {
+        float error = mesh.lods[std::min(i, mesh.lods.size() - 1)].error;
+        this->lod_errors[i] = std::max(this->lod_errors[i], error);
+    }
+}
+
+GLuint Model::get_material_id() const {
+    // the first texture of the first mesh stands in for the model's texture set when sorting draws
+    if (this->meshes.empty() || this->meshes[0].textures.empty()) {
+        return 0;
+    }
+    return this->meshes[0].textures[0].id;
+}
+
 void Model::load_model(std::string path) {
+    this->directory = path.substr(0, path.find_last_of('/'));
+
+    // a cache built from the same source file and import flags replaces the whole import
+    std::string cache_path = MeshCache::get_cache_path(path);
+    MeshCacheKey key;
+    bool has_key = MeshCache::make_key(path, Model::import_flags, this->optimize_flags, key);
+
+    if (has_key) {
+        auto start = std::chrono::high_resolution_clock::now();
+        MappedFile file(cache_path);
+
+        if (this->load_cached_model(file, key)) {
+            auto end = std::chrono::high_resolution_clock::now();
+            std::cout << "Loaded model " << path << " from " << cache_path << " in "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+                << " ms" << std::endl;
+            return;
+        }
+    }
+
     // import assimp model
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
+    const aiScene* scene = importer.ReadFile(path, Model::import_flags);
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         std::cerr << "Error importing model: " << importer.GetErrorString() << std::endl;
@@ -17,35 +73,103 @@ void Model::load_model(std::string path) {
     }
 
     std::cout << "Imported model " << path << std::endl;
-    this->directory = path.substr(0, path.find_last_of('/'));
 
-    // recursively process model from root node
+    // CPU phase: gather the meshes in node order, then convert them all in parallel without touching GL
     auto start = std::chrono::high_resolution_clock::now();
-    this->process_node(scene->mRootNode, scene);
+    std::vector<const aiMesh*> ai_meshes;
+    this->process_node(scene->mRootNode, scene, ai_meshes);
+
+    int64_t mesh_count = ai_meshes.size();
+    std::vector<ImportedMesh> imported_meshes(mesh_count);
+    std::vector<VertexCacheStats> stats_before(mesh_count), stats_after(mesh_count);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int64_t i = 0; i < mesh_count; i++) {
+        imported_meshes[i] = process_mesh(ai_meshes[i], scene);
+
+        if (this->optimize_flags) {
+            MeshData& data = imported_meshes[i].data;
+            stats_before[i] = MeshOptimizer::analyze_vertex_cache(data.indices, data.vertices.size());
+            MeshOptimizer::optimize(data, this->optimize_flags);
+
+            // compared on the full detail level, the same triangles as before
+            size_t full_detail = data.lods.empty() ? data.indices.size() : data.lods[0].index_count;
+            std::vector<GLuint> indices(data.indices.begin(), data.indices.begin() + full_detail);
+            stats_after[i] = MeshOptimizer::analyze_vertex_cache(indices, data.vertices.size());
+        }
+    }
+    auto converted = std::chrono::high_resolution_clock::now();
+
+    if (this->optimize_flags) {
+        for (int64_t i = 0; i < mesh_count; i++) {
+            const MeshData& data = imported_meshes[i].data;
+            std::cout << "Optimized mesh " << i << " ("
+                << (data.lods.empty() ? data.indices.size() : data.lods[0].index_count) / 3
+                << " triangles): ACMR " << stats_before[i].acmr << " -> " << stats_after[i].acmr
+                << ", ATVR " << stats_before[i].atvr << " -> " << stats_after[i].atvr;
+            for (size_t lod = 1; lod < data.lods.size(); lod++) {
+                std::cout << (lod == 1 ? ", LODs " : ", ") << data.lods[lod].index_count / 3
+                    << " (error " << data.lods[lod].error << ")";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    // GL phase: create the textures and buffers
+    this->upload_meshes(imported_meshes);
     auto end = std::chrono::high_resolution_clock::now();
 
-    std::cout << "Processing " << path << " took " 
-        << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+    std::cout << "Converting " << mesh_count << " meshes of " << path << " took "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(converted - start).count()
+        << " ms, uploading took "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(end - converted).count()
         << " ms" << std::endl;
+
+    if (has_key) {
+        MeshCache::write(cache_path, key, this->meshes);
+    }
 }
 
-void Model::process_node(aiNode* node, const aiScene* scene) {
+bool Model::load_cached_model(const MappedFile& file, const MeshCacheKey& key) {
+    std::vector<MeshView> views;
+    if (!MeshCache::read(file, key, views)) {
+        return false;
+    }
+
+    std::vector<TextureRef> texture_refs;
+    for (const MeshView& view : views) {
+        texture_refs.insert(texture_refs.end(), view.textures.begin(), view.textures.end());
+    }
+    std::vector<Texture> textures = this->load_material_textures(texture_refs);
+
+    auto next_texture = textures.begin();
+    for (const MeshView& view : views) {
+        auto end_texture = next_texture + view.textures.size();
+        this->meshes.emplace_back(view, std::vector<Texture>(next_texture, end_texture), this->vertex_format,
+                                  this->keep_cpu_data);
+        next_texture = end_texture;
+        this->bounds.expand(this->meshes.back().bounds);
+        this->add_lod_errors(this->meshes.back());
+    }
+    return true;
+}
+
+void Model::process_node(const aiNode* node, const aiScene* scene, std::vector<const aiMesh*>& ai_meshes) {
     // process node's meshes first
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        this->meshes.push_back(process_mesh(mesh, scene));
+        ai_meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
 
     // recursively process child meshes
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        this->process_node(node->mChildren[i], scene);
+        this->process_node(node->mChildren[i], scene, ai_meshes);
     }
 }
 
-Mesh Model::process_mesh(aiMesh* mesh, const aiScene* scene) {
-    std::vector<Vertex> vertices;
-    std::vector<GLuint> indices;
-    std::vector<Texture> textures;
+ImportedMesh Model::process_mesh(const aiMesh* mesh, const aiScene* scene) {
+    ImportedMesh result;
+    std::vector<Vertex>& vertices = result.data.vertices;
+    std::vector<GLuint>& indices = result.data.indices;
 
     vertices.reserve(mesh->mNumVertices);
 
@@ -87,50 +211,54 @@ Mesh Model::process_mesh(aiMesh* mesh, const aiScene* scene) {
     material_types.push_back({material, aiTextureType_HEIGHT, "texture_normal"});
     material_types.push_back({material, aiTextureType_AMBIENT, "texture_height"});
 
-    std::vector<Texture> texture_maps = load_material_textures(material_types);
-    textures.insert(textures.end(), texture_maps.begin(), texture_maps.end());
+    for (const MaterialType& material_type : material_types) {
+        // get all textures associated with current material
+        aiTextureType type = material_type.type;
+        for (unsigned int i = 0; i < material_type.material->GetTextureCount(type); i++) {
+            aiString texture_path;
+            material_type.material->GetTexture(type, i, &texture_path); // retrieve texture file location
+            result.texture_refs.push_back({material_type.type_name, texture_path.C_Str()});
+        }
+    }
 
-    return Mesh(vertices, indices, textures);
+    return result;
 }
 
-std::vector<Texture> Model::load_material_textures(const std::vector<MaterialType>& material_types) {
-    std::vector<Texture> textures;
-    std::vector<std::string> unloaded_textures, unloaded_types, unloaded_paths;
+void Model::upload_meshes(std::vector<ImportedMesh>& imported_meshes) {
+    // resolve the textures of every mesh in one batch so all uncached images decode concurrently
+    std::vector<TextureRef> texture_refs;
+    for (const ImportedMesh& mesh : imported_meshes) {
+        texture_refs.insert(texture_refs.end(), mesh.texture_refs.begin(), mesh.texture_refs.end());
+    }
+    std::vector<Texture> textures = this->load_material_textures(texture_refs);
 
-    for (const auto& [material, type, type_name] : material_types) {
-        // get all textures associated with current material
-        for (unsigned int i = 0; i < material->GetTextureCount(type); i++) {
-            aiString texture_path;
-            material->GetTexture(type, i, &texture_path); // retrieve texture file location
-            bool skip = false;
-
-            for (size_t j = 0; j < this->loaded_textures.size(); j++) {
-                // check if texture already loaded
-                if (std::strcmp(this->loaded_textures[j].path.data(), texture_path.C_Str()) == 0) {
-                    textures.push_back(this->loaded_textures[j]);
-                    skip = true;
-                    break;
-                }
-            }
+    this->meshes.reserve(this->meshes.size() + imported_meshes.size());
+    auto next_texture = textures.begin();
+    for (ImportedMesh& mesh : imported_meshes) {
+        auto end_texture = next_texture + mesh.texture_refs.size();
+        std::vector<Texture> mesh_textures(next_texture, end_texture);
+        next_texture = end_texture;
 
-            // if texture not loaded, add to pool of unloaded textures
-            if (!skip) {
-                unloaded_textures.emplace_back(this->directory + "/" + texture_path.C_Str());
-                unloaded_types.push_back(type_name);
-                unloaded_paths.emplace_back(texture_path.C_Str());
-            }
-        }
+        this->meshes.emplace_back(std::move(mesh.data.vertices), std::move(mesh.data.indices), std::move(mesh_textures),
+                                  this->vertex_format, std::move(mesh.data.lods));
+        this->bounds.expand(this->meshes.back().bounds);
+        this->add_lod_errors(this->meshes.back());
     }
+}
 
-    // load all unloaded textures together asynchronously for speed up
-    std::vector<Texture> new_textures = Texture::load_textures(unloaded_textures);
-    for (size_t i = 0; i < new_textures.size(); i++) {
-        new_textures[i].type = unloaded_types[i];
-        new_textures[i].path = unloaded_paths[i];
+std::vector<Texture> Model::load_material_textures(const std::vector<TextureRef>& texture_refs) {
+    std::vector<std::string> texture_paths;
+    texture_paths.reserve(texture_refs.size());
+    for (const TextureRef& ref : texture_refs) {
+        texture_paths.push_back(this->directory + "/" + ref.path);
     }
 
-    textures.insert(textures.end(), new_textures.begin(), new_textures.end());
-    this->loaded_textures.insert(this->loaded_textures.end(), new_textures.begin(), new_textures.end());
+    // shared with every other model using the same images, only the uncached ones are loaded
+    std::vector<Texture> textures = TextureCache::load(texture_paths);
+    for (size_t i = 0; i < textures.size(); i++) {
+        textures[i].type = texture_refs[i].type;
+        textures[i].path = texture_refs[i].path;
+    }
 
     return textures;
 }
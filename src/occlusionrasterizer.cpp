@@ -0,0 +1,270 @@
+#include "occlusionrasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+OcclusionRasterizer::OcclusionRasterizer(int width, int height) {
+    this->resize(width, height);
+}
+
+void OcclusionRasterizer::resize(int width, int height) {
+    this->width = width;
+    this->height = height;
+    this->tiles_x = (width + tile_width - 1) / tile_width;
+    this->tiles_y = (height + tile_height - 1) / tile_height;
+    this->stride = this->tiles_x * tile_width;
+
+    // rows are padded to whole tiles, so the 8 pixel loads and stores of a tile never leave the buffer
+    this->depth.assign(this->stride * this->tiles_y * tile_height, 1.0f);
+    this->bins.assign(this->tiles_x * this->tiles_y, {});
+}
+
+void OcclusionRasterizer::begin(const glm::mat4& view_projection) {
+    this->view_projection = view_projection;
+    this->triangles.clear();
+    for (std::vector<uint32_t>& bin : this->bins) {
+        bin.clear();
+    }
+    std::fill(this->depth.begin(), this->depth.end(), 1.0f);
+}
+
+void OcclusionRasterizer::add_occluder(const std::vector<Vertex>& vertices, const GLuint* indices,
+                                       size_t index_count, const glm::mat4& world) {
+    glm::mat4 world_view_projection = this->view_projection * world;
+    this->clip_vertices.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        this->clip_vertices[i] = world_view_projection * glm::vec4(vertices[i].position, 1.0f);
+    }
+
+    for (size_t i = 0; i + 2 < index_count; i += 3) {
+        glm::vec4 clip[3] = {
+            this->clip_vertices[indices[i]],
+            this->clip_vertices[indices[i + 1]],
+            this->clip_vertices[indices[i + 2]]
+        };
+        this->add_triangle(clip);
+    }
+}
+
+void OcclusionRasterizer::add_occluder(const MeshData& mesh, const glm::mat4& world) {
+    size_t index_count = mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].index_count;
+    this->add_occluder(mesh.vertices, mesh.indices.data(), index_count, world);
+}
+
+void OcclusionRasterizer::add_triangle(const glm::vec4* clip) {
+    // clip against the near plane, z >= -w, which leaves a triangle or a quad
+    glm::vec4 polygon[4];
+    int count = 0;
+    for (int i = 0; i < 3; i++) {
+        const glm::vec4& a = clip[i];
+        const glm::vec4& b = clip[(i + 1) % 3];
+        float distance_a = a.z + a.w;
+        float distance_b = b.z + b.w;
+
+        if (distance_a >= 0.0f) {
+            polygon[count++] = a;
+        }
+        if ((distance_a >= 0.0f) != (distance_b >= 0.0f)) {
+            polygon[count++] = a + (b - a) * (distance_a / (distance_a - distance_b));
+        }
+    }
+    if (count < 3) {
+        return;
+    }
+
+    glm::vec3 screen[4];
+    for (int i = 0; i < count; i++) {
+        glm::vec3 ndc = glm::vec3(polygon[i]) / polygon[i].w;
+        screen[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * this->width, (ndc.y * 0.5f + 0.5f) * this->height,
+                              ndc.z * 0.5f + 0.5f);
+    }
+
+    this->setup_triangle(screen[0], screen[1], screen[2]);
+    if (count == 4) {
+        this->setup_triangle(screen[0], screen[2], screen[3]);
+    }
+}
+
+void OcclusionRasterizer::setup_triangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (std::fabs(area) < 1e-8f) {
+        return;
+    }
+
+    Triangle triangle;
+    triangle.min_x = std::max(0, static_cast<int>(std::floor(std::min({v0.x, v1.x, v2.x}))));
+    triangle.min_y = std::max(0, static_cast<int>(std::floor(std::min({v0.y, v1.y, v2.y}))));
+    triangle.max_x = std::min(this->width - 1, static_cast<int>(std::ceil(std::max({v0.x, v1.x, v2.x}))));
+    triangle.max_y = std::min(this->height - 1, static_cast<int>(std::ceil(std::max({v0.y, v1.y, v2.y}))));
+    if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) {
+        return;
+    }
+
+    // counter-clockwise order keeps every edge function positive inside, the winding of the mesh is ignored
+    const glm::vec3* v[3] = {&v0, &v1, &v2};
+    if (area < 0.0f) {
+        std::swap(v[1], v[2]);
+        area = -area;
+    }
+    for (int i = 0; i < 3; i++) {
+        const glm::vec3& a = *v[i];
+        const glm::vec3& b = *v[(i + 1) % 3];
+        triangle.edge_a[i] = a.y - b.y;
+        triangle.edge_b[i] = b.x - a.x;
+        triangle.edge_c[i] = a.x * b.y - b.x * a.y;
+    }
+
+    // depth is affine in screen space after the perspective divide
+    const glm::vec3& a = *v[0];
+    const glm::vec3& b = *v[1];
+    const glm::vec3& c = *v[2];
+    triangle.z_dx = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+    triangle.z_dy = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+    triangle.z = a.z - triangle.z_dx * a.x - triangle.z_dy * a.y;
+
+    uint32_t index = this->triangles.size();
+    this->triangles.push_back(triangle);
+
+    for (int tile_y = triangle.min_y / tile_height; tile_y <= triangle.max_y / tile_height; tile_y++) {
+        for (int tile_x = triangle.min_x / tile_width; tile_x <= triangle.max_x / tile_width; tile_x++) {
+            this->bins[tile_y * this->tiles_x + tile_x].push_back(index);
+        }
+    }
+}
+
+void OcclusionRasterizer::rasterize() {
+    // tiles share no pixels, so each thread owns the tiles it takes
+    int tile_count = this->tiles_x * this->tiles_y;
+    #pragma omp parallel for schedule(dynamic)
+    for (int tile = 0; tile < tile_count; tile++) {
+        this->rasterize_tile(tile);
+    }
+}
+
+void OcclusionRasterizer::rasterize_tile(int tile) {
+    int tile_min_x = (tile % this->tiles_x) * tile_width;
+    int tile_min_y = (tile / this->tiles_x) * tile_height;
+
+    for (uint32_t index : this->bins[tile]) {
+        const Triangle& triangle = this->triangles[index];
+        // the 8 pixel steps start on a multiple of 8, tiles are wide enough to hold the overhang
+        int min_x = std::max(triangle.min_x, tile_min_x) & ~7;
+        int max_x = std::min(triangle.max_x, tile_min_x + tile_width - 1);
+        int min_y = std::max(triangle.min_y, tile_min_y);
+        int max_y = std::min(triangle.max_y, tile_min_y + tile_height - 1);
+
+        for (int y = min_y; y <= max_y; y++) {
+            // pixel centers
+            float center_y = y + 0.5f;
+            float row[3];
+            for (int i = 0; i < 3; i++) {
+                row[i] = triangle.edge_b[i] * center_y + triangle.edge_c[i];
+            }
+            float row_z = triangle.z_dy * center_y + triangle.z;
+            float* depth_row = &this->depth[y * this->stride];
+            int x = min_x;
+
+#if defined(__AVX2__)
+            const __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+            const __m256 zero = _mm256_setzero_ps();
+            __m256 edge_a0 = _mm256_set1_ps(triangle.edge_a[0]);
+            __m256 edge_a1 = _mm256_set1_ps(triangle.edge_a[1]);
+            __m256 edge_a2 = _mm256_set1_ps(triangle.edge_a[2]);
+            __m256 row0 = _mm256_set1_ps(row[0]);
+            __m256 row1 = _mm256_set1_ps(row[1]);
+            __m256 row2 = _mm256_set1_ps(row[2]);
+            __m256 z_dx = _mm256_set1_ps(triangle.z_dx);
+            __m256 z_row = _mm256_set1_ps(row_z);
+
+            for (; x <= max_x; x += 8) {
+                __m256 center_x = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), offsets);
+                __m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edge_a0, center_x), row0), zero, _CMP_GE_OQ);
+                inside = _mm256_and_ps(inside,
+                    _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edge_a1, center_x), row1), zero, _CMP_GE_OQ));
+                inside = _mm256_and_ps(inside,
+                    _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edge_a2, center_x), row2), zero, _CMP_GE_OQ));
+                if (_mm256_movemask_ps(inside) == 0) {
+                    continue;
+                }
+
+                __m256 z = _mm256_add_ps(_mm256_mul_ps(z_dx, center_x), z_row);
+                __m256 previous = _mm256_loadu_ps(depth_row + x);
+                _mm256_storeu_ps(depth_row + x, _mm256_blendv_ps(previous, _mm256_min_ps(previous, z), inside));
+            }
+#endif
+
+            // scalar path for targets without AVX2
+            for (; x <= max_x; x++) {
+                float center_x = x + 0.5f;
+                if (triangle.edge_a[0] * center_x + row[0] >= 0.0f
+                    && triangle.edge_a[1] * center_x + row[1] >= 0.0f
+                    && triangle.edge_a[2] * center_x + row[2] >= 0.0f) {
+                    depth_row[x] = std::min(depth_row[x], triangle.z_dx * center_x + row_z);
+                }
+            }
+        }
+    }
+}
+
+bool OcclusionRasterizer::is_visible(const BoundingBox& box) const {
+    glm::vec2 min_screen = glm::vec2(static_cast<float>(this->width), static_cast<float>(this->height));
+    glm::vec2 max_screen = glm::vec2(0.0f);
+    float min_depth = 1.0f;
+
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner = glm::vec3(i & 1 ? box.max.x : box.min.x,
+                                     i & 2 ? box.max.y : box.min.y,
+                                     i & 4 ? box.max.z : box.min.z);
+        glm::vec4 clip = this->view_projection * glm::vec4(corner, 1.0f);
+
+        // reaches behind the camera
+        if (clip.w <= 0.0f) {
+            return true;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        glm::vec2 screen = (glm::vec2(ndc) * 0.5f + 0.5f) * glm::vec2(this->width, this->height);
+        min_screen = glm::min(min_screen, screen);
+        max_screen = glm::max(max_screen, screen);
+        min_depth = std::min(min_depth, ndc.z * 0.5f + 0.5f);
+    }
+
+    // the parts outside the screen are left to frustum culling
+    int min_x = std::max(0, static_cast<int>(std::floor(min_screen.x)));
+    int min_y = std::max(0, static_cast<int>(std::floor(min_screen.y)));
+    int max_x = std::min(this->width - 1, static_cast<int>(std::floor(max_screen.x)));
+    int max_y = std::min(this->height - 1, static_cast<int>(std::floor(max_screen.y)));
+    if (min_x > max_x || min_y > max_y) {
+        return true;
+    }
+
+    // visible as soon as one pixel's occluder is not in front of the box
+    for (int y = min_y; y <= max_y; y++) {
+        const float* depth_row = &this->depth[y * this->stride];
+        int x = min_x;
+
+#if defined(__AVX2__)
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256 box_depth = _mm256_set1_ps(min_depth);
+        for (; x <= max_x; x += 8) {
+            // lanes past max_x are neither loaded nor tested, on the last row of a buffer without padding rows
+            // they would read past its end
+            __m256i in_range = _mm256_cmpgt_epi32(_mm256_set1_epi32(max_x - x + 1), lanes);
+            __m256 not_hidden = _mm256_cmp_ps(_mm256_maskload_ps(depth_row + x, in_range), box_depth, _CMP_GE_OQ);
+            if (_mm256_movemask_ps(_mm256_and_ps(_mm256_castsi256_ps(in_range), not_hidden)) != 0) {
+                return true;
+            }
+        }
+#else
+        for (; x <= max_x; x++) {
+            if (depth_row[x] >= min_depth) {
+                return true;
+            }
+        }
+#endif
+    }
+    return false;
+}
@@ -17,6 +17,8 @@ const std::vector<glm::vec3> window_positions = {
     glm::vec3( 0.5f,  0.0f, -0.6f),
 };
 
+constexpr uint32_t outline_shader_id = 2;
+
 void Renderer::init() {
     glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
     glEnable(GL_DEPTH_TEST);
@@ -26,21 +28,61 @@ void Renderer::init() {
 
     // SHADERS
 
-    Shader model_shader("assets/shaders/model_vertex.glsl", "assets/shaders/model_fragment.glsl");
+    // entity shaders read their model matrix from the per-instance attribute, and their indirect
+    // variants fetch it from the transform storage buffer for multi-draw indirect submission
+    std::vector<std::string> instanced = {"INSTANCED"};
+    std::vector<std::string> indirect = {"INDIRECT"};
+
+    // the vertex stage decodes whatever layout the meshes were packed in, the pool keeps float positions
+    VertexFormat pool_format = this->vertex_format;
+    pool_format.quantize_positions = false;
+    for (const std::string& define : this->vertex_format.get_defines()) {
+        instanced.push_back(define);
+    }
+    for (const std::string& define : pool_format.get_defines()) {
+        indirect.push_back(define);
+    }
+
+    Shader model_shader("assets/shaders/model_vertex.glsl", "assets/shaders/model_fragment.glsl", instanced);
     this->shaders.push_back(std::move(model_shader));
+    this->indirect_shaders.emplace_back("assets/shaders/model_vertex.glsl", "assets/shaders/model_fragment.glsl", indirect);
 
-    Shader container_shader("assets/shaders/vertex.glsl", "assets/shaders/box_fragment.glsl");
+    Shader container_shader("assets/shaders/vertex.glsl", "assets/shaders/box_fragment.glsl", instanced);
+    Shader indirect_container_shader("assets/shaders/vertex.glsl", "assets/shaders/box_fragment.glsl", indirect);
 
-    Texture container_texture("assets/textures/container2.png");
-    Texture specular_map("assets/textures/container2_specular.png");
+    std::vector<Texture> container_textures = TextureCache::load(std::vector<std::string>{
+        "assets/textures/container2.png", "assets/textures/container2_specular.png"}, true, &this->texture_streamer);
 
-    container_shader.use();
-    container_shader.set("material.diffuse", container_texture.unit);
-    container_shader.set("material.specular", specular_map.unit);
+    this->shininess_uniform = container_shader.get_uniform("material.shininess");
+    this->indirect_shininess_uniform = indirect_container_shader.get_uniform("material.shininess");
     this->shaders.push_back(std::move(container_shader));
+    this->indirect_shaders.push_back(std::move(indirect_container_shader));
 
-    Shader outline_shader("assets/shaders/model_vertex.glsl", "assets/shaders/light_fragment.glsl");
+    Shader outline_shader("assets/shaders/model_vertex.glsl", "assets/shaders/light_fragment.glsl", instanced);
     this->shaders.push_back(std::move(outline_shader));
+    this->indirect_shaders.emplace_back("assets/shaders/model_vertex.glsl", "assets/shaders/light_fragment.glsl", indirect);
+
+    // the container's maps are not part of its generated mesh, every draw with its shader samples them
+    this->shader_textures = {
+        {},
+        {{"material.diffuse", container_textures[0]}, {"material.specular", container_textures[1]}},
+        {},
+    };
+    for (size_t shader_id = 0; shader_id < this->shader_textures.size(); shader_id++) {
+        for (ShaderTexture& shader_texture : this->shader_textures[shader_id]) {
+            shader_texture.location = this->shaders[shader_id].get_uniform(shader_texture.sampler);
+            shader_texture.indirect_location = this->indirect_shaders[shader_id].get_uniform(shader_texture.sampler);
+        }
+    }
+    for (const Shader& shader : this->indirect_shaders) {
+        this->material_array_uniforms.push_back(shader.get_uniform("material_array"));
+    }
+
+    this->camera_buffer.bind();
+    this->camera_buffer.allocate<CameraData>(UniformBlock::CameraBlock);
+    this->lights_buffer.bind();
+    this->lights_buffer.allocate<LightsData>(UniformBlock::LightsBlock);
+    this->lights_buffer.unbind();
 
     // MODELS
 
@@ -53,94 +95,118 @@ void Renderer::init() {
     }
 
     // Create a texture and add it to the mesh
-    Texture metal_texture("assets/textures/metal.png");
+    Texture metal_texture = TextureCache::load("assets/textures/metal.png", true, &this->texture_streamer);
     metal_texture.set_type(Texture::Type::Diffuse);
     plane_mesh.textures.push_back(metal_texture);
 
     // Add the mesh to the model
-    plane_model.add_mesh(Mesh(plane_mesh));
+    plane_model.add_mesh(Mesh(plane_mesh, this->vertex_format));
 
     Model container_model;
     MeshData container_mesh = Mesh::generate_cube_mesh();
-    container_model.add_mesh(Mesh(container_mesh));
+    container_model.add_mesh(Mesh(container_mesh, this->vertex_format));
 
     Model window_model;
     MeshData window_mesh = Mesh::generate_plane_mesh();
 
-    Texture window_texture("assets/textures/blending_transparent_window.png");
+    Texture window_texture = TextureCache::load("assets/textures/blending_transparent_window.png", true, &this->texture_streamer);
     window_texture.set_type(Texture::Type::Diffuse);
     window_mesh.textures.push_back(window_texture);
     
-    window_model.add_mesh(window_mesh);
+    window_model.add_mesh(Mesh(window_mesh, this->vertex_format));
 
     Model cube_model;
     MeshData cube_mesh = Mesh::generate_cube_mesh();
 
-    Texture marble_texture("assets/textures/marble.jpg");
+    Texture marble_texture = TextureCache::load("assets/textures/marble.jpg", true, &this->texture_streamer);
     marble_texture.set_type(Texture::Type::Diffuse);
     cube_mesh.textures.push_back(marble_texture);
 
-    cube_model.add_mesh(Mesh(cube_mesh));
+    cube_model.add_mesh(Mesh(cube_mesh, this->vertex_format));
     
     this->models.push_back(std::move(plane_model));
     this->models.push_back(std::move(container_model));
     this->models.push_back(std::move(window_model));
     this->models.push_back(std::move(cube_model));
 
-    // TRANSFORMS
-
-    Transform plane_transform(1.0f);
-    plane_transform = glm::translate(plane_transform, glm::vec3(0.0f, -0.5f, 0.0f));
-    plane_transform = glm::scale(plane_transform, glm::vec3(5.0f));
-    this->transforms.push_back(std::move(plane_transform));
-
-    Transform container_transform(1.0f);
-    this->transforms.push_back(std::move(container_transform));
-
-    Transform cube1_transform(1.0f);
-    cube1_transform = glm::translate(cube1_transform, glm::vec3(-1.0f, 0.0f, -1.0f));
-    this->transforms.push_back(cube1_transform);
-
-    Transform cube2_transform(1.0f);
-    cube2_transform = glm::translate(cube2_transform, glm::vec3(2.0f, 0.0f, 0.0f));
-    this->transforms.push_back(cube2_transform);
-
-    // scaled cube transforms for outline
-    cube1_transform = glm::scale(cube1_transform, glm::vec3(1.01f));
-    cube2_transform = glm::scale(cube2_transform, glm::vec3(1.01f));
-    this->transforms.push_back(std::move(cube1_transform));
-    this->transforms.push_back(std::move(cube2_transform));
-
-    for (const auto& pos : window_positions) {
-        Transform window_transform(1.0f);
-        window_transform = glm::translate(window_transform, pos);
-        window_transform = glm::rotate(window_transform, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        this->transforms.push_back(std::move(window_transform));
+    // GEOMETRY POOL
+
+    // suballocate every mesh from the shared buffers and give each distinct texture set a material index
+    for (const Model& model : this->models) {
+        std::vector<PooledMesh> model_meshes;
+
+        for (const Mesh& mesh : model.get_meshes()) {
+            if (mesh.indices.empty()) {
+                std::cerr << "Mesh has no CPU copy to add to the geometry pool, load its model with keep_cpu_data."
+                          << std::endl;
+                std::terminate();
+            }
+
+            auto same_textures = [&mesh](const std::vector<Texture>& material) {
+                if (material.size() != mesh.textures.size()) {
+                    return false;
+                }
+                for (size_t i = 0; i < mesh.textures.size(); i++) {
+                    if (material[i].id != mesh.textures[i].id) {
+                        return false;
+                    }
+                }
+                return true;
+            };
+
+            auto material = std::find_if(this->materials.begin(), this->materials.end(), same_textures);
+            GLuint material_index = material - this->materials.begin();
+            if (material == this->materials.end()) {
+                this->materials.push_back(mesh.textures);
+            }
+
+            // meshes of more than one meshlet are split so their parts can be culled one by one. Only the full
+            // detail level is, the coarser ones are drawn far enough away to not be worth it.
+            std::vector<GLuint> indices = mesh.indices;
+            std::vector<Meshlet> meshlets;
+            const MeshLod& full_detail = mesh.lods[0];
+            if (full_detail.index_count / 3 > MeshletBuilder::max_triangles) {
+                auto begin = indices.begin() + full_detail.first_index;
+                std::vector<GLuint> meshlet_indices(begin, begin + full_detail.index_count);
+                meshlets = MeshletBuilder::build(mesh.vertices, meshlet_indices);
+                std::copy(meshlet_indices.begin(), meshlet_indices.end(), begin);
+            }
+            model_meshes.push_back({this->geometry_pool.add_mesh(mesh.vertices, indices), material_index, mesh.lods,
+                                    std::move(meshlets)});
+        }
+        this->pooled_meshes.push_back(std::move(model_meshes));
     }
+    this->geometry_pool.upload(pool_format);
+    this->material_table.build(this->materials);
+    this->material_table_textures = this->texture_streamer.get_finished_count();
 
     // ENTITIES
 
     // Add plane
-    this->entities.push_back({0, 0, 0});
+    EntityHandle plane = this->scene.create(0, 0, OpaqueTag | OccluderTag);
+    this->scene.set_position(plane, glm::vec3(0.0f, -0.5f, 0.0f));
+    this->scene.set_scale(plane, glm::vec3(5.0f));
 
     // Add container
-    this->entities.push_back({1, 1, 1});
-    
-    // Add two marble cubes
-    this->entities.push_back({0, 3, 2, true});
-    this->entities.push_back({0, 3, 3, true});
+    this->scene.create(1, 1, OpaqueTag | OccluderTag);
 
-    // Add upscaled cubes for stencil drawing
-    this->stencil_entities.push_back({2, 3, 4});
-    this->stencil_entities.push_back({2, 3, 5});
+    // Add two marble cubes, highlighted until picked
+    EntityHandle cube1 = this->scene.create(0, 3, OpaqueTag | HighlightedTag);
+    this->scene.set_position(cube1, glm::vec3(-1.0f, 0.0f, -1.0f));
+    EntityHandle cube2 = this->scene.create(0, 3, OpaqueTag | HighlightedTag);
+    this->scene.set_position(cube2, glm::vec3(2.0f, 0.0f, 0.0f));
 
-    // Add window
-    for (size_t i = 0; i < window_positions.size(); i++) {
-        float distance = glm::length(window->state.camera_pos - window_positions[i]);
-        this->transparent_entities[distance] = {0, 2, 6 + i};
+    // Add windows
+    for (const auto& pos : window_positions) {
+        EntityHandle window_entity = this->scene.create(0, 2, TransparentTag);
+        this->scene.set_position(window_entity, pos);
+        this->scene.set_rotation(window_entity, glm::angleAxis(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)));
     }
 
     this->framebuffer = Framebuffer(this->window->width, this->window->height);
+    this->hiz_buffer.init(this->framebuffer.width, this->framebuffer.height);
+    // a fixed width keeps the cost of the software occluders independent of the window size
+    this->occlusion_rasterizer.resize(320, std::max(1, 320 * this->framebuffer.height / this->framebuffer.width));
 
     const std::vector<std::string> faces = {
         "assets/textures/skybox/right.jpg",
@@ -153,6 +219,11 @@ void Renderer::init() {
 
     this->skybox = CubeMap(faces);
 
+    // a headless window has no input or screen for the debug menu
+    if (window->is_headless()) {
+        return;
+    }
+
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -167,8 +238,20 @@ void Renderer::init() {
 }
 
 void Renderer::update() {
+    this->texture_streamer.update();
+
+    // the table holds copies, so pick up textures that finished streaming since it was last updated
+    if (this->texture_streamer.get_finished_count() != this->material_table_textures) {
+        this->material_table.update(this->materials);
+        this->material_table_textures = this->texture_streamer.get_finished_count();
+    }
+
+    // bindings made outside the frame (resource creation, ImGui) bypass the state cache
+    GLState::invalidate();
+    GLState::reset_counters();
+
     float prev_time = window->state.curr_time;
-    float curr_time = glfwGetTime();
+    float curr_time = window->get_time();
     float delta_time = curr_time - prev_time;
 
     window->state.curr_time = curr_time;
@@ -182,48 +265,85 @@ void Renderer::update() {
        glm::vec3( 0.0f,  0.0f, -3.0f)
     };
 
-    const Shader& container_shader = this->shaders[1];
-    container_shader.use();
+    // camera
+    this->camera.view = glm::lookAt(window->state.camera_pos,
+                                    window->state.camera_pos + window->state.camera_front,
+                                    window->state.camera_up);
 
-    container_shader.set("material.shininess", window->state.shininess);
+    float aspect_ratio = static_cast<float>(window->width) / window->height;
+    this->camera.projection = glm::perspective(glm::radians(window->state.fov), aspect_ratio, near_plane, far_plane);
+    this->camera.view_pos = window->state.camera_pos;
 
     // directional lights
-    glm::vec3 light_dir(-0.2f, -1.0f, -0.3f);
-    container_shader.set("dirLight.direction", light_dir);
-    container_shader.set("dirLight.ambient", window->state.dirlight_ambient);
-    container_shader.set("dirLight.diffuse", window->state.dirlight_diffuse);
-    container_shader.set("dirLight.specular", window->state.dirlight_specular);
-    container_shader.set("viewPos", window->state.camera_pos);
+    this->lights.dir_light.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    this->lights.dir_light.ambient = window->state.dirlight_ambient;
+    this->lights.dir_light.diffuse = window->state.dirlight_diffuse;
+    this->lights.dir_light.specular = window->state.dirlight_specular;
 
     // point lights
-    for (int i = 0; i < 4; i++) {
-        std::string pointLight = "pointLights[" + std::to_string(i) + "]";
-        container_shader.set(pointLight + ".position", pointLightPositions[i]);
-        container_shader.set(pointLight + ".ambient", window->state.pointlight_ambient);
-        container_shader.set(pointLight + ".diffuse", window->state.pointlight_diffuse);
-        container_shader.set(pointLight + ".specular", window->state.pointlight_specular);
-        container_shader.set(pointLight + ".constant", 1.0f);
-        container_shader.set(pointLight + ".linear", 0.09f);
-        container_shader.set(pointLight + ".quadratic", 0.032f);
+    for (int i = 0; i < n_point_lights; i++) {
+        PointLightData& point_light = this->lights.point_lights[i];
+        point_light.position = pointLightPositions[i];
+        point_light.ambient = window->state.pointlight_ambient;
+        point_light.diffuse = window->state.pointlight_diffuse;
+        point_light.specular = window->state.pointlight_specular;
+        point_light.constant = 1.0f;
+        point_light.linear = 0.09f;
+        point_light.quadratic = 0.032f;
     }
 
     // spotlight
-    container_shader.set("spotLight.position", window->state.camera_pos);
-    container_shader.set("spotLight.direction", window->state.camera_front);
-    container_shader.set("spotLight.cutoff", glm::cos(glm::radians(window->state.cutoff)));
-    container_shader.set("spotLight.outerCutoff", glm::cos(glm::radians(window->state.outer_cutoff)));
-    container_shader.set("spotLight.ambient", window->state.spotlight_ambient);
-    container_shader.set("spotLight.diffuse", window->state.spotlight_diffuse);
-    container_shader.set("spotLight.specular", window->state.spotlight_specular);
-    container_shader.set("spotLight.constant", 1.0f);
-    container_shader.set("spotLight.linear", 0.09f);
-    container_shader.set("spotLight.quadratic", 0.032f);
-
-    // TODO: replace with inplace sort?
-    this->transparent_entities.clear();
-    for (size_t i = 0; i < window_positions.size(); i++) {
-        float distance = glm::length(window->state.camera_pos - window_positions[i]);
-        this->transparent_entities[distance] = {0, 2, 6 + i};
+    SpotLightData& spot_light = this->lights.spot_light;
+    spot_light.position = window->state.camera_pos;
+    spot_light.direction = window->state.camera_front;
+    spot_light.cutoff = glm::cos(glm::radians(window->state.cutoff));
+    spot_light.outer_cutoff = glm::cos(glm::radians(window->state.outer_cutoff));
+    spot_light.ambient = window->state.spotlight_ambient;
+    spot_light.diffuse = window->state.spotlight_diffuse;
+    spot_light.specular = window->state.spotlight_specular;
+    spot_light.constant = 1.0f;
+    spot_light.linear = 0.09f;
+    spot_light.quadratic = 0.032f;
+
+    // upload once per frame, every program reads these through its uniform blocks
+    this->camera_buffer.bind();
+    this->camera_buffer.write_buffer_data(this->camera);
+    this->lights_buffer.bind();
+    this->lights_buffer.write_buffer_data(this->lights);
+    this->lights_buffer.unbind();
+
+    const Shader& container_shader = this->shaders[1];
+    container_shader.use();
+    container_shader.set(this->shininess_uniform, window->state.shininess);
+
+    const Shader& indirect_container_shader = this->indirect_shaders[1];
+    indirect_container_shader.use();
+    indirect_container_shader.set(this->indirect_shininess_uniform, window->state.shininess);
+
+    // clicks on the debug menu are meant for ImGui, not the scene
+    if (window->state.pick_requested) {
+        window->state.pick_requested = false;
+        if (!ImGui::GetIO().WantCaptureMouse) {
+            this->pick_entity(window->state.pick_x, window->state.pick_y);
+        }
+    }
+
+    // a pyramid left over from before occlusion culling or the GPU path was switched off is stale
+    auto hiz_start = std::chrono::high_resolution_clock::now();
+    if (!window->state.use_occlusion_culling || window->state.use_software_occlusion) {
+        this->hiz_buffer.reset();
+    }
+    this->hiz_buffer.update();
+    auto hiz_end = std::chrono::high_resolution_clock::now();
+    this->hiz_build_time = std::chrono::duration<float, std::milli>(hiz_end - hiz_start).count();
+
+    this->frame_count++;
+    this->update_scene();
+    this->cull_entities();
+    this->build_render_queue();
+    this->build_batches();
+    if (window->state.use_indirect) {
+        this->build_indirect_commands();
     }
 }
 
@@ -239,79 +359,53 @@ void Renderer::render() {
     glStencilFunc(GL_ALWAYS, 1, 0xFF);  // have fragments always pass the stencil test
     glStencilMask(0x00);                // disable writing to stencil buffer
 
-    glm::mat4 view = glm::lookAt(window->state.camera_pos,
-                                 window->state.camera_pos + window->state.camera_front,
-                                 window->state.camera_up);
-
-    glm::mat4 projection;
-    float aspect_ratio = static_cast<float>(window->width) / window->height;
-    projection = glm::perspective(glm::radians(window->state.fov), aspect_ratio, 0.1f, 100.0f);
-
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
     glFrontFace(GL_CW);
 
-    for (const Entity& entity : this->entities) {
-        const Shader& shader = this->shaders[entity.shader_id];
-        const Model& model = this->models[entity.model_id];
-        const Transform& transform = this->transforms[entity.transform_id];
-
-        if (entity.is_highlighted) {
-            glStencilMask(0xFF); // enable writing to stencil buffer
-        } else {
-            glStencilMask(0x00); // disable writing to stencil buffer
-        }
-
-        shader.use();
-        shader.set("model", transform);
-        shader.set("view", view);
-        shader.set("projection", projection);
-
-        model.draw(shader);
+    if (window->state.use_indirect) {
+        this->draw_indirect();
+    } else {
+        this->draw_batches(this->opaque_batches);
     }
 
     glStencilMask(0x00);
     glDisable(GL_CULL_FACE);
 
+    // only opaque entities occlude, so the depth is reduced before the skybox and transparent objects
+    if (window->state.use_occlusion_culling && !window->state.use_software_occlusion) {
+        auto start = std::chrono::high_resolution_clock::now();
+        this->hiz_buffer.build(this->framebuffer.depth_texture, this->camera.projection * this->camera.view,
+                               this->frame_count);
+        auto end = std::chrono::high_resolution_clock::now();
+        this->hiz_build_time += std::chrono::duration<float, std::milli>(end - start).count();
+
+        this->framebuffer.bind();
+        glViewport(0, 0, this->framebuffer.width, this->framebuffer.height);
+        glEnable(GL_BLEND);
+    }
+
     // Render skybox
-    this->skybox.draw(view, projection);
+    this->skybox.draw();
 
     // Render transparent objects from furthest to nearest so alpha blending works correctly
-    for (auto it = this->transparent_entities.rbegin(); it != this->transparent_entities.rend(); it++) {
-        const Entity& entity = it->second;
-        const Shader& shader = this->shaders[entity.shader_id];
-        const Model& model = this->models[entity.model_id];
-        const Transform& transform = this->transforms[entity.transform_id];
-
-        shader.use();
-        shader.set("model", transform);
-        shader.set("view", view);
-        shader.set("projection", projection);
-
-        model.draw(shader);
-    }
+    this->draw_batches(this->transparent_batches);
 
     // Draw stenciled i.e. highlighted objects
     glStencilFunc(GL_NOTEQUAL, 1, 0xFF);    // only pass fragments not overlapping with cubes
     glStencilMask(0x00);                    // disable writing to stencil buffer
     glDisable(GL_DEPTH_TEST);               // always draw outline regardless of depth
 
-    for (const Entity& entity : this->stencil_entities) {
-        const Shader& shader = this->shaders[entity.shader_id];
-        const Model& model = this->models[entity.model_id];
-        const Transform& transform = this->transforms[entity.transform_id];
-
-        shader.use();
-        shader.set("model", transform);
-        shader.set("view", view);
-        shader.set("projection", projection);
-
-        model.draw(shader);
-    }
+    this->draw_batches(this->outline_batches);
 
     glStencilFunc(GL_ALWAYS, 1, 0xFF);  // have fragments always pass the stencil test
     glStencilMask(0xFF);                // enable writing to stencil buffer so it can be cleared
 
+    // a headless window has no default framebuffer, the frame stays in ours
+    if (window->is_headless()) {
+        return;
+    }
+
     // Switch back to default framebuffer
     this->framebuffer.unbind();
     glDisable(GL_DEPTH_TEST);           // we don't want any fragments to be discarded
@@ -321,6 +415,457 @@ void Renderer::render() {
     this->framebuffer.draw_to_screen();
 }
 
+FrameStats Renderer::get_frame_stats() const {
+    return {this->scene_update_time, this->cull_time, this->occlusion_time + this->occluder_raster_time,
+            this->visible_count, this->occluded_count};
+}
+
+void Renderer::update_scene() {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // only entities whose world matrix changed are refitted, and their leaves only move in the tree
+    // when the new box escapes the fattened one
+    const std::vector<uint32_t>& changed = this->scene.update_world_matrices();
+    const std::vector<glm::mat4>& world_matrices = this->scene.get_world_matrices();
+    this->bvh_proxies.resize(this->scene.size(), BVH::null_node);
+    this->moved_frames.resize(this->scene.size(), 0);
+
+    for (uint32_t index : changed) {
+        int& proxy = this->bvh_proxies[index];
+        this->moved_frames[index] = this->frame_count;
+
+        if (!this->scene.is_alive(index)) {
+            if (proxy != BVH::null_node) {
+                this->bvh.remove(proxy);
+                proxy = BVH::null_node;
+            }
+            continue;
+        }
+
+        const BoundingBox& bounds = this->models[this->scene.model_ids[index]].get_bounds();
+        BoundingBox box = bounds.transform(world_matrices[index]);
+
+        if (proxy == BVH::null_node) {
+            proxy = this->bvh.insert(box, index);
+        } else {
+            this->bvh.update(proxy, box);
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    this->scene_update_time = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void Renderer::pick_entity(double x_pos, double y_pos) {
+    // unproject the cursor onto the near and far planes to get a world-space ray
+    float x = 2.0f * static_cast<float>(x_pos) / window->width - 1.0f;
+    float y = 1.0f - 2.0f * static_cast<float>(y_pos) / window->height;
+
+    glm::mat4 inverse_view_projection = glm::inverse(this->camera.projection * this->camera.view);
+    glm::vec4 near_point = inverse_view_projection * glm::vec4(x, y, -1.0f, 1.0f);
+    glm::vec4 far_point = inverse_view_projection * glm::vec4(x, y, 1.0f, 1.0f);
+
+    glm::vec3 origin = glm::vec3(near_point) / near_point.w;
+    glm::vec3 direction = glm::normalize(glm::vec3(far_point) / far_point.w - origin);
+
+    // hits are against the entities' boxes, transparent entities are skipped so the ray passes through them
+    auto is_pickable = [this](uint32_t index) {
+        return (this->scene.tags[index] & OpaqueTag) != 0;
+    };
+
+    uint32_t hit;
+    float distance;
+    if (this->bvh.raycast(origin, direction, hit, distance, is_pickable)) {
+        this->scene.tags[hit] ^= HighlightedTag;
+    }
+}
+
+void Renderer::cull_entities() {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    Frustum frustum(this->camera.projection * this->camera.view);
+    std::fill(this->scene.visible.begin(), this->scene.visible.end(), 0);
+
+    if (window->state.use_bvh) {
+        // whole subtrees are accepted or rejected at once, only leaves near the frustum's planes are tested
+        this->bvh_results.clear();
+        this->bvh.query_frustum(frustum, this->bvh_results);
+
+        for (uint32_t index : this->bvh_results) {
+            this->scene.visible[index] = 1;
+        }
+        this->visible_count = this->bvh_results.size();
+        this->culled_count = this->bvh.get_leaf_count() - this->visible_count;
+    } else {
+        // gather world-space bounds of every drawn entity, then test them in one SIMD batch
+        const std::vector<glm::mat4>& world_matrices = this->scene.get_world_matrices();
+        this->culler.clear();
+        this->cull_indices.clear();
+
+        for (uint32_t i = 0; i < this->scene.size(); i++) {
+            if (this->scene.tags[i] & (OpaqueTag | TransparentTag)) {
+                const BoundingBox& bounds = this->models[this->scene.model_ids[i]].get_bounds();
+                this->culler.add(bounds.transform(world_matrices[i]));
+                this->cull_indices.push_back(i);
+            }
+        }
+
+        this->visible_count = this->culler.cull(frustum, this->visibility);
+        this->culled_count = this->culler.size() - this->visible_count;
+
+        for (size_t i = 0; i < this->cull_indices.size(); i++) {
+            this->scene.visible[this->cull_indices[i]] = this->visibility[i];
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    this->cull_time = std::chrono::duration<float, std::milli>(end - start).count();
+
+    this->occluded_count = 0;
+    this->occlusion_time = 0.0f;
+    this->occluder_raster_time = 0.0f;
+    this->hiz_view_stale = false;
+    bool use_software = window->state.use_software_occlusion;
+    if (!window->state.use_occlusion_culling || (!use_software && !this->hiz_buffer.is_ready())) {
+        return;
+    }
+
+    // the pyramid lags the camera by the read back, testing against it while the view moves would keep
+    // anything the motion uncovered culled until the next one lands
+    this->hiz_view_stale = !use_software
+        && !this->hiz_buffer.is_view_current(this->camera.projection * this->camera.view);
+    if (this->hiz_view_stale) {
+        return;
+    }
+
+    const std::vector<glm::mat4>& world_matrices = this->scene.get_world_matrices();
+    if (use_software) {
+        // only the visible occluders, meshes loaded from the mesh cache without keep_cpu_data have nothing to draw
+        this->occlusion_rasterizer.begin(this->camera.projection * this->camera.view);
+        for (uint32_t i = 0; i < this->scene.size(); i++) {
+            if (!this->scene.visible[i] || !(this->scene.tags[i] & OccluderTag)) {
+                continue;
+            }
+            for (const Mesh& mesh : this->models[this->scene.model_ids[i]].get_meshes()) {
+                if (!mesh.indices.empty()) {
+                    this->occlusion_rasterizer.add_occluder(mesh.vertices, mesh.indices.data(),
+                                                            mesh.lods[0].index_count, world_matrices[i]);
+                }
+            }
+        }
+        this->occlusion_rasterizer.rasterize();
+
+        auto raster_end = std::chrono::high_resolution_clock::now();
+        this->occluder_raster_time = std::chrono::duration<float, std::milli>(raster_end - end).count();
+    }
+    auto test_start = std::chrono::high_resolution_clock::now();
+
+    // entities that moved after the frame the pyramid was rendered in could be hidden behind their own old
+    // image, however many frames the read back took, and highlighted ones keep their outline showing through
+    // walls. Software occluders are drawn from this frame's transforms, but would only hide themselves
+    // behind their own rounded depth
+    uint64_t depth_frame = this->hiz_buffer.get_frame();
+    for (uint32_t i = 0; i < this->scene.size(); i++) {
+        if (!this->scene.visible[i] || (this->scene.tags[i] & HighlightedTag)) {
+            continue;
+        }
+        if (use_software ? (this->scene.tags[i] & OccluderTag) != 0 : this->moved_frames[i] > depth_frame) {
+            continue;
+        }
+
+        const BoundingBox& bounds = this->models[this->scene.model_ids[i]].get_bounds();
+        BoundingBox world_bounds = bounds.transform(world_matrices[i]);
+        if (use_software ? !this->occlusion_rasterizer.is_visible(world_bounds)
+                         : this->hiz_buffer.is_occluded(world_bounds)) {
+            this->scene.visible[i] = 0;
+            this->occluded_count++;
+        }
+    }
+    this->visible_count -= this->occluded_count;
+
+    auto occlusion_end = std::chrono::high_resolution_clock::now();
+    this->occlusion_time = std::chrono::duration<float, std::milli>(occlusion_end - test_start).count();
+}
+
+void Renderer::build_render_queue() {
+    this->render_queue.clear();
+    const std::vector<glm::mat4>& world_matrices = this->scene.get_world_matrices();
+    this->entity_lods.resize(this->scene.size());
+    this->reduced_lod_count = 0;
+
+    // pixels covered by one unit of length at unit distance, along the screen's height
+    float pixels_per_unit = window->height / (2.0f * std::tan(glm::radians(window->state.fov) * 0.5f));
+
+    // an entity is pushed once for every pass it is tagged with
+    for (uint32_t i = 0; i < this->scene.size(); i++) {
+        uint32_t tags = this->scene.tags[i];
+        if (!this->scene.visible[i]) {
+            continue;
+        }
+
+        uint32_t model_id = this->scene.model_ids[i];
+        uint32_t material_id = this->models[model_id].get_material_id();
+        float distance = glm::length(window->state.camera_pos - glm::vec3(world_matrices[i][3]));
+
+        // the simplification error is in object space, so the entity's scale enlarges it too
+        const Model& model = this->models[model_id];
+        uint8_t& lod = this->entity_lods[i];
+        lod = 0;
+        if (model.get_lod_count() > 1) {
+            const glm::mat4& world = world_matrices[i];
+            float scale = std::max({glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])),
+                                    glm::length(glm::vec3(world[2]))});
+            float error_scale = scale * pixels_per_unit / std::max(distance, near_plane);
+            lod = model.select_lod(error_scale, window->state.lod_error_pixels);
+            this->reduced_lod_count += lod > 0;
+        }
+
+        if (tags & OpaqueTag) {
+            uint64_t key = RenderQueue::make_key(RenderPass::Opaque, this->scene.shader_ids[i], material_id, model_id,
+                                                 distance / far_plane);
+            this->render_queue.push(key, i);
+        }
+        if (tags & TransparentTag) {
+            this->render_queue.push(RenderQueue::make_depth_key(RenderPass::Transparent, distance), i);
+        }
+        if (tags & HighlightedTag) {
+            uint64_t key = RenderQueue::make_key(RenderPass::Outline, outline_shader_id, material_id, model_id,
+                                                 distance / far_plane);
+            this->render_queue.push(key, i);
+        }
+    }
+
+    // the radix sort is stable, so transparent entities at equal distances keep their scene order
+    this->render_queue.sort();
+}
+
+void Renderer::build_batches() {
+    this->instance_transforms.clear();
+    this->opaque_batches.clear();
+    this->transparent_batches.clear();
+    this->outline_batches.clear();
+
+    const std::vector<glm::mat4>& world_matrices = this->scene.get_world_matrices();
+
+    // the queue is sorted by pass first: opaque, then transparent furthest to nearest, then outlines.
+    // instances of one draw are rasterized in order, so batching keeps the blending order intact
+    for (const RenderCommand& command : this->render_queue.commands) {
+        uint32_t i = command.index;
+        uint32_t shader_id = this->scene.shader_ids[i];
+        uint32_t model_id = this->scene.model_ids[i];
+        uint32_t lod = this->entity_lods[i];
+        bool is_highlighted = this->scene.tags[i] & HighlightedTag;
+
+        switch (RenderQueue::get_pass(command.key)) {
+            case RenderPass::Opaque:
+                // the indirect path submits opaque entities from the geometry pool instead
+                if (!window->state.use_indirect) {
+                    this->add_to_batch(this->opaque_batches, shader_id, model_id, lod, is_highlighted,
+                                       world_matrices[i]);
+                }
+                break;
+            case RenderPass::Transparent:
+                this->add_to_batch(this->transparent_batches, shader_id, model_id, lod, is_highlighted,
+                                   world_matrices[i]);
+                break;
+            case RenderPass::Outline:
+                // outlines are slightly upscaled copies drawn where the entity did not write to the stencil buffer
+                this->add_to_batch(this->outline_batches, outline_shader_id, model_id, lod, false,
+                                   glm::scale(world_matrices[i], glm::vec3(1.01f)));
+                break;
+        }
+    }
+
+    // orphan the previous frame's storage so the upload does not wait on draws still using it
+    this->instance_buffer.bind();
+    this->instance_buffer.write_buffer_data(this->instance_transforms, GL_STREAM_DRAW);
+    this->instance_buffer.unbind();
+}
+
+void Renderer::add_to_batch(std::vector<DrawBatch>& batches, uint32_t shader_id, uint32_t model_id, uint32_t lod,
+                            bool is_highlighted, const Transform& transform) {
+    GLuint instance = this->instance_transforms.size();
+    this->instance_transforms.push_back(transform);
+
+    if (!batches.empty()) {
+        DrawBatch& batch = batches.back();
+        bool is_contiguous = batch.first_instance + batch.instance_count == instance;
+
+        if (is_contiguous
+            && batch.shader_id == shader_id
+            && batch.model_id == model_id
+            && batch.lod == lod
+            && batch.is_highlighted == is_highlighted) {
+            batch.instance_count++;
+            return;
+        }
+    }
+
+    batches.push_back({shader_id, model_id, lod, is_highlighted, instance, 1});
+}
+
+void Renderer::draw_batches(const std::vector<DrawBatch>& batches) {
+    for (const DrawBatch& batch : batches) {
+        const Shader& shader = this->shaders[batch.shader_id];
+        const Model& model = this->models[batch.model_id];
+
+        // only highlighted entities write to the stencil buffer
+        glStencilMask(batch.is_highlighted ? 0xFF : 0x00);
+
+        shader.use();
+        this->bind_shader_textures(batch.shader_id, false);
+        model.draw_instanced(shader, this->instance_buffer.id, batch.first_instance, batch.instance_count,
+                             batch.lod);
+    }
+}
+
+void Renderer::bind_shader_textures(uint32_t shader_id, bool indirect) {
+    const Shader& shader = indirect ? this->indirect_shaders[shader_id] : this->shaders[shader_id];
+    for (const ShaderTexture& shader_texture : this->shader_textures[shader_id]) {
+        GLuint unit = GLState::bind_texture(GL_TEXTURE_2D, shader_texture.texture.id);
+        shader.set(indirect ? shader_texture.indirect_location : shader_texture.location, static_cast<int>(unit));
+    }
+}
+
+void Renderer::build_indirect_commands() {
+    this->indirect_commands.clear();
+    this->draw_data.clear();
+    this->indirect_groups.clear();
+    this->meshlet_count = 0;
+    this->backfacing_meshlets = 0;
+    this->offscreen_meshlets = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    Frustum frustum(this->camera.projection * this->camera.view);
+    const std::vector<glm::mat4>& world_matrices = this->scene.get_world_matrices();
+
+    // one command per mesh, or per run of visible meshlets, split into groups wherever the shader, texture
+    // array or stencil state changes
+    for (const RenderCommand& command : this->render_queue.commands) {
+        if (RenderQueue::get_pass(command.key) != RenderPass::Opaque) {
+            break;
+        }
+        uint32_t i = command.index;
+        uint32_t shader_id = this->scene.shader_ids[i];
+        bool is_highlighted = this->scene.tags[i] & HighlightedTag;
+        uint32_t lod = this->entity_lods[i];
+        const glm::mat4& world = world_matrices[i];
+
+        // the camera in object space for the cone tests, only computed for entities that have meshlets. Cones
+        // are only exact under uniform scale, which is all the scene uses.
+        bool has_object_camera = false;
+        glm::vec3 object_camera;
+        float world_scale = 0.0f;
+
+        for (const PooledMesh& mesh : this->pooled_meshes[this->scene.model_ids[i]]) {
+            GLuint texture_array = this->material_table.get_array(mesh.material_index);
+            if (this->indirect_groups.empty()
+                || this->indirect_groups.back().shader_id != shader_id
+                || this->indirect_groups.back().texture_array != texture_array
+                || this->indirect_groups.back().is_highlighted != is_highlighted) {
+                this->indirect_groups.push_back({
+                    shader_id,
+                    texture_array,
+                    is_highlighted,
+                    this->indirect_commands.size(),
+                    0
+                });
+            }
+
+            auto add_command = [&](GLuint first_index, GLuint index_count) {
+                GLuint draw_index = this->indirect_commands.size();
+                this->indirect_commands.push_back({
+                    index_count,
+                    1,
+                    first_index,
+                    mesh.range.base_vertex,
+                    draw_index
+                });
+                this->draw_data.push_back({i, mesh.material_index});
+                this->indirect_groups.back().command_count++;
+            };
+
+            if (mesh.meshlets.empty() || lod > 0 || !window->state.use_meshlet_culling) {
+                const MeshLod& range = mesh.lods[std::min<size_t>(lod, mesh.lods.size() - 1)];
+                add_command(mesh.range.first_index + range.first_index, range.index_count);
+                continue;
+            }
+
+            if (!has_object_camera) {
+                object_camera = glm::vec3(glm::inverse(world) * glm::vec4(this->camera.view_pos, 1.0f));
+                world_scale = std::max({glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])),
+                                        glm::length(glm::vec3(world[2]))});
+                has_object_camera = true;
+            }
+
+            size_t mesh_first_command = this->indirect_commands.size();
+            this->meshlet_count += mesh.meshlets.size();
+
+            for (const Meshlet& meshlet : mesh.meshlets) {
+                if (MeshletBuilder::is_backfacing(meshlet, object_camera)) {
+                    this->backfacing_meshlets++;
+                    continue;
+                }
+
+                BoundingSphere world_sphere = {
+                    glm::vec3(world * glm::vec4(meshlet.sphere.center, 1.0f)),
+                    meshlet.sphere.radius * world_scale
+                };
+                if (!frustum.intersects(world_sphere)) {
+                    this->offscreen_meshlets++;
+                    continue;
+                }
+
+                // meshlets are contiguous in the index buffer, so visible neighbours share one command
+                GLuint first_index = mesh.range.first_index + meshlet.first_index;
+                if (this->indirect_commands.size() > mesh_first_command) {
+                    DrawElementsIndirectCommand& previous = this->indirect_commands.back();
+                    if (previous.first_index + previous.count == first_index) {
+                        previous.count += meshlet.index_count;
+                        continue;
+                    }
+                }
+                add_command(first_index, meshlet.index_count);
+            }
+        }
+    }
+
+    // a group can be left empty when every meshlet of its meshes was culled
+    this->indirect_groups.erase(std::remove_if(this->indirect_groups.begin(), this->indirect_groups.end(),
+        [](const IndirectGroup& group) { return group.command_count == 0; }), this->indirect_groups.end());
+
+    auto end = std::chrono::high_resolution_clock::now();
+    this->meshlet_cull_time = std::chrono::duration<float, std::milli>(end - start).count();
+
+    // indexed by entity slot, destroyed slots are uploaded too but never referenced
+    this->transform_storage.bind();
+    this->transform_storage.write_buffer_data(this->scene.get_world_matrices(), GL_DYNAMIC_DRAW);
+    this->transform_storage.bind_base(StorageBlock::TransformsStorage);
+
+    this->draw_data_storage.bind();
+    this->draw_data_storage.write_buffer_data(this->draw_data, GL_STREAM_DRAW);
+    this->draw_data_storage.bind_base(StorageBlock::DrawDataStorage);
+    this->draw_data_storage.unbind();
+
+    this->geometry_pool.write_commands(this->indirect_commands);
+}
+
+void Renderer::draw_indirect() {
+    for (const IndirectGroup& group : this->indirect_groups) {
+        const Shader& shader = this->indirect_shaders[group.shader_id];
+
+        // only highlighted entities write to the stencil buffer
+        glStencilMask(group.is_highlighted ? 0xFF : 0x00);
+
+        // each draw finds its layer through its DrawData, so only a change of array needs a bind
+        shader.use();
+        this->bind_shader_textures(group.shader_id, true);
+        shader.set(this->material_array_uniforms[group.shader_id],
+                   static_cast<int>(this->material_table.bind_array(group.texture_array)));
+        this->geometry_pool.draw(group.first_command, group.command_count);
+    }
+}
+
 void Renderer::render_ui() {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -340,6 +885,32 @@ void Renderer::render_ui() {
         ImGui::Text("Last mouse position: (%d, %d)", window->state.last_x, window->state.last_y);
         ImGui::Text("Pitch: %.1f, Yaw: %.1f", window->state.pitch, window->state.yaw);
         ImGui::Text("FOV: %.1f", window->state.fov);
+        ImGui::Text("Draw Calls: %d", GLState::draw_calls);
+        ImGui::Text("Frustum Culling: %zu visible, %zu culled (%.3f ms)",
+                    this->visible_count, this->culled_count, this->cull_time);
+        if (window->state.use_software_occlusion) {
+            ImGui::Text("Occlusion Culling: %zu occluded (tested in %.3f ms, %zu occluder triangles in %.3f ms)",
+                        this->occluded_count, this->occlusion_time, this->occlusion_rasterizer.get_triangle_count(),
+                        this->occluder_raster_time);
+        } else {
+            ImGui::Text("Occlusion Culling: %zu occluded (tested in %.3f ms, depth pyramid %.3f ms%s)",
+                        this->occluded_count, this->occlusion_time, this->hiz_build_time,
+                        this->hiz_view_stale ? ", paused while the camera moves" : "");
+        }
+        ImGui::Text("Entities: %zu (world matrices and BVH updated in %.3f ms)",
+                    this->scene.get_entity_count(), this->scene_update_time);
+        ImGui::Text("BVH: %zu leaves, height %d", this->bvh.get_leaf_count(), this->bvh.get_height());
+        ImGui::Text("Cached Textures: %zu (%zu streaming, %zu KB uploaded)", TextureCache::get_texture_count(),
+            this->texture_streamer.get_pending_count(), this->texture_streamer.get_uploaded_bytes() / 1024);
+        ImGui::Text("Material Arrays: %zu (%zu layers)", this->material_table.get_array_count(),
+            this->material_table.get_layer_count());
+        ImGui::Text("Meshlets: %zu (%zu backfacing, %zu off screen culled in %.3f ms)", this->meshlet_count,
+            this->backfacing_meshlets, this->offscreen_meshlets, this->meshlet_cull_time);
+        ImGui::Text("Levels of Detail: %zu of %zu visible entities reduced", this->reduced_lod_count,
+            this->visible_count);
+        ImGui::Text("Vertex Size: %d bytes (%d pooled, %zu unpacked)", this->vertex_format.get_stride(),
+            this->geometry_pool.get_vertex_format().get_stride(), sizeof(Vertex));
+        ImGui::Text("State Changes: %d (%d redundant skipped)", GLState::state_changes, GLState::redundant_changes);
         ImGui::Text("Camera Direction: (%.3f, %.3f, %.3f)",
                     window->state.camera_front.x,
                     window->state.camera_front.y,
@@ -350,6 +921,13 @@ void Renderer::render_ui() {
                     window->state.camera_pos.z);
 
         ImGui::SeparatorText("Settings");
+        ImGui::Checkbox("Multi-Draw Indirect", &window->state.use_indirect);
+        ImGui::Checkbox("BVH Culling", &window->state.use_bvh);
+        ImGui::Checkbox("Meshlet Culling", &window->state.use_meshlet_culling);
+        ImGui::Checkbox("Occlusion Culling", &window->state.use_occlusion_culling);
+        ImGui::Checkbox("Software Occlusion", &window->state.use_software_occlusion);
+        ImGui::Text("LOD Error (pixels)");
+        ImGui::SliderFloat("##LodError", &window->state.lod_error_pixels, 0.0f, 8.0f, "%.1f");
         ImGui::Text("Camera Speed");
         ImGui::SliderFloat("##CameraSpeed", &window->state.camera_speed, 0.1f, 10.0f, "%.1f");
         ImGui::Text("Camera Sensitivity");
@@ -0,0 +1,73 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+uint64_t RenderQueue::make_key(RenderPass pass, uint32_t shader_id, uint32_t material_id, uint32_t model_id,
+                               float depth) {
+    constexpr uint32_t depth_bits = 20;
+    constexpr uint32_t max_depth = (1u << depth_bits) - 1;
+    uint64_t quantized_depth = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * max_depth);
+
+    return (static_cast<uint64_t>(pass) & 0xF) << 60
+        | (static_cast<uint64_t>(shader_id) & 0x3FF) << 50
+        | (static_cast<uint64_t>(material_id) & 0xFFFF) << 34
+        | (static_cast<uint64_t>(model_id) & 0x3FFF) << 20
+        | quantized_depth;
+}
+
+uint64_t RenderQueue::make_depth_key(RenderPass pass, float distance) {
+    // flip the sign bit of positive floats and every bit of negative ones, so the unsigned bit patterns
+    // order the same way as the floats themselves
+    uint32_t bits;
+    std::memcpy(&bits, &distance, sizeof(bits));
+    bits ^= (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+
+    return (static_cast<uint64_t>(pass) & 0xF) << 60 | static_cast<uint64_t>(~bits);
+}
+
+void RenderQueue::sort() {
+    // LSD radix sort on 8-bit digits. All histograms are built in a single pass over the keys, and
+    // digits that are identical for every command (common for the high bits) are skipped entirely.
+    constexpr int n_digits = sizeof(uint64_t);
+    size_t length = this->commands.size();
+    if (length < 2) {
+        return;
+    }
+
+    uint32_t histograms[n_digits][256] = {};
+    for (const RenderCommand& command : this->commands) {
+        for (int d = 0; d < n_digits; d++) {
+            histograms[d][(command.key >> (8 * d)) & 0xFF]++;
+        }
+    }
+
+    this->scratch.resize(length);
+    std::vector<RenderCommand>* src = &this->commands;
+    std::vector<RenderCommand>* dst = &this->scratch;
+
+    for (int d = 0; d < n_digits; d++) {
+        uint32_t* histogram = histograms[d];
+        uint32_t first_digit = ((*src)[0].key >> (8 * d)) & 0xFF;
+        if (histogram[first_digit] == length) {
+            continue;
+        }
+
+        // exclusive prefix sum gives the output offset of each bucket
+        uint32_t offset = 0;
+        for (int i = 0; i < 256; i++) {
+            uint32_t count = histogram[i];
+            histogram[i] = offset;
+            offset += count;
+        }
+
+        for (const RenderCommand& command : *src) {
+            (*dst)[histogram[(command.key >> (8 * d)) & 0xFF]++] = command;
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != &this->commands) {
+        this->commands.swap(this->scratch);
+    }
+}
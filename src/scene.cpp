@@ -0,0 +1,285 @@
+#include "scene.h"
+
+#if defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+constexpr uint32_t null_index = EntityHandle::null_index;
+
+EntityHandle Scene::create(uint32_t shader_id, uint32_t model_id, uint32_t tags, EntityHandle parent) {
+    uint32_t parent_index = parent.is_null() ? null_index : this->check(parent);
+    uint32_t index;
+
+    if (this->free_slots.empty()) {
+        index = this->alive.size();
+        this->shader_ids.emplace_back();
+        this->model_ids.emplace_back();
+        this->tags.emplace_back();
+        this->visible.emplace_back();
+        this->positions.emplace_back();
+        this->rotations.emplace_back();
+        this->scales.emplace_back();
+        this->world_matrices.emplace_back();
+        this->parents.emplace_back();
+        this->first_children.emplace_back();
+        this->next_siblings.emplace_back();
+        this->depths.emplace_back();
+        this->generations.push_back(0);
+        this->alive.emplace_back();
+        this->dirty.push_back(0);
+    } else {
+        index = this->free_slots.back();
+        this->free_slots.pop_back();
+    }
+
+    this->shader_ids[index] = shader_id;
+    this->model_ids[index] = model_id;
+    this->tags[index] = tags;
+    this->visible[index] = 1;
+    this->positions[index] = glm::vec3(0.0f);
+    this->rotations[index] = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    this->scales[index] = glm::vec3(1.0f);
+    this->world_matrices[index] = glm::mat4(1.0f);
+    this->alive[index] = 1;
+
+    this->parents[index] = parent_index;
+    this->first_children[index] = null_index;
+    this->next_siblings[index] = null_index;
+    this->depths[index] = parent_index == null_index ? 0 : this->depths[parent_index] + 1;
+    this->levels_dirty = true;
+    if (parent_index != null_index) {
+        this->next_siblings[index] = this->first_children[parent_index];
+        this->first_children[parent_index] = index;
+    }
+
+    this->mark_dirty(index);
+    return {index, this->generations[index]};
+}
+
+void Scene::destroy(EntityHandle handle) {
+    uint32_t index = this->check(handle);
+
+    // unlink from the parent's child list
+    uint32_t parent = this->parents[index];
+    if (parent != null_index) {
+        uint32_t* link = &this->first_children[parent];
+        while (*link != index) {
+            link = &this->next_siblings[*link];
+        }
+        *link = this->next_siblings[index];
+    }
+
+    this->stack.clear();
+    this->stack.push_back(index);
+    while (!this->stack.empty()) {
+        uint32_t i = this->stack.back();
+        this->stack.pop_back();
+
+        for (uint32_t child = this->first_children[i]; child != null_index; child = this->next_siblings[child]) {
+            this->stack.push_back(child);
+        }
+
+        this->alive[i] = 0;
+        this->tags[i] = 0;
+        this->visible[i] = 0;
+        this->generations[i]++;
+        this->parents[i] = null_index;
+        this->first_children[i] = null_index;
+        this->free_slots.push_back(i);
+
+        // reported as changed on the next update so cached world-space data can be dropped
+        this->mark_dirty(i);
+    }
+    this->levels_dirty = true;
+}
+
+bool Scene::is_alive(EntityHandle handle) const {
+    return handle.index < this->alive.size()
+        && this->alive[handle.index]
+        && this->generations[handle.index] == handle.generation;
+}
+
+void Scene::set_position(EntityHandle handle, const glm::vec3& position) {
+    uint32_t index = this->check(handle);
+    this->positions[index] = position;
+    this->mark_dirty(index);
+}
+
+void Scene::set_rotation(EntityHandle handle, const glm::quat& rotation) {
+    uint32_t index = this->check(handle);
+    this->rotations[index] = rotation;
+    this->mark_dirty(index);
+}
+
+void Scene::set_scale(EntityHandle handle, const glm::vec3& scale) {
+    uint32_t index = this->check(handle);
+    this->scales[index] = scale;
+    this->mark_dirty(index);
+}
+
+const std::vector<uint32_t>& Scene::update_world_matrices() {
+    this->changed_slots.clear();
+
+    if (this->dirty_slots.size() >= parallel_threshold) {
+        this->update_parallel();
+        this->dirty_slots.clear();
+        return this->changed_slots;
+    }
+
+    for (uint32_t index : this->dirty_slots) {
+        // already updated as part of a dirty ancestor's subtree
+        if (!this->dirty[index]) {
+            continue;
+        }
+
+        if (!this->alive[index]) {
+            this->dirty[index] = 0;
+            this->changed_slots.push_back(index);
+            continue;
+        }
+
+        // a dirty ancestor will update this entity together with the rest of its subtree
+        bool has_dirty_ancestor = false;
+        for (uint32_t parent = this->parents[index]; parent != null_index; parent = this->parents[parent]) {
+            if (this->dirty[parent]) {
+                has_dirty_ancestor = true;
+                break;
+            }
+        }
+        if (!has_dirty_ancestor) {
+            this->update_subtree(index);
+        }
+    }
+
+    this->dirty_slots.clear();
+    return this->changed_slots;
+}
+
+// column-major 4x4 product, each result column is a linear combination of the columns of a
+static glm::mat4 multiply(const glm::mat4& a, const glm::mat4& b) {
+#if defined(__SSE__)
+    __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    __m128 a3 = _mm_loadu_ps(&a[3][0]);
+
+    glm::mat4 result;
+    for (int c = 0; c < 4; c++) {
+        __m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[c][0]));
+        column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[c][1])));
+        column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+        column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[c][3])));
+        _mm_storeu_ps(&result[c][0], column);
+    }
+    return result;
+#else
+    return a * b;
+#endif
+}
+
+void Scene::compute_world_matrix(uint32_t index) {
+    // translation * rotation * scale, built directly instead of through three matrix products
+    glm::mat3 rotation = glm::mat3_cast(this->rotations[index]);
+    const glm::vec3& scale = this->scales[index];
+
+    glm::mat4 local;
+    local[0] = glm::vec4(rotation[0] * scale.x, 0.0f);
+    local[1] = glm::vec4(rotation[1] * scale.y, 0.0f);
+    local[2] = glm::vec4(rotation[2] * scale.z, 0.0f);
+    local[3] = glm::vec4(this->positions[index], 1.0f);
+
+    uint32_t parent = this->parents[index];
+    this->world_matrices[index] = parent == null_index ? local : multiply(this->world_matrices[parent], local);
+}
+
+void Scene::update_subtree(uint32_t index) {
+    this->stack.clear();
+    this->stack.push_back(index);
+
+    while (!this->stack.empty()) {
+        uint32_t i = this->stack.back();
+        this->stack.pop_back();
+
+        this->compute_world_matrix(i);
+        this->dirty[i] = 0;
+        this->changed_slots.push_back(i);
+
+        for (uint32_t child = this->first_children[i]; child != null_index; child = this->next_siblings[child]) {
+            this->stack.push_back(child);
+        }
+    }
+}
+
+void Scene::update_levels() {
+    for (std::vector<uint32_t>& level : this->levels) {
+        level.clear();
+    }
+
+    for (uint32_t i = 0; i < this->alive.size(); i++) {
+        if (!this->alive[i]) {
+            continue;
+        }
+        uint32_t depth = this->depths[i];
+        if (depth >= this->levels.size()) {
+            this->levels.resize(depth + 1);
+        }
+        this->levels[depth].push_back(i);
+    }
+    this->levels_dirty = false;
+}
+
+void Scene::update_parallel() {
+    if (this->levels_dirty) {
+        this->update_levels();
+    }
+    this->world_changed.resize(this->alive.size());
+
+    // destroyed slots are not part of any level
+    for (uint32_t index : this->dirty_slots) {
+        if (!this->alive[index]) {
+            this->dirty[index] = 0;
+            this->changed_slots.push_back(index);
+        }
+    }
+
+    // every parent is finished before its level's children start, so each level is a parallel loop
+    for (const std::vector<uint32_t>& level : this->levels) {
+        int64_t count = level.size();
+
+        #pragma omp parallel for schedule(static) if(count >= 256)
+        for (int64_t k = 0; k < count; k++) {
+            uint32_t i = level[k];
+            uint32_t parent = this->parents[i];
+
+            if (this->dirty[i] || (parent != null_index && this->world_changed[parent])) {
+                this->compute_world_matrix(i);
+                this->dirty[i] = 0;
+                this->world_changed[i] = 1;
+            } else {
+                this->world_changed[i] = 0;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < this->alive.size(); i++) {
+        if (this->alive[i] && this->world_changed[i]) {
+            this->changed_slots.push_back(i);
+        }
+    }
+}
+
+uint32_t Scene::check(EntityHandle handle) const {
+    if (!this->is_alive(handle)) {
+        std::cerr << "Invalid entity handle (index " << handle.index << ", generation " << handle.generation
+                  << ") used on Scene" << std::endl;
+        std::terminate();
+    }
+    return handle.index;
+}
+
+void Scene::mark_dirty(uint32_t index) {
+    if (!this->dirty[index]) {
+        this->dirty[index] = 1;
+        this->dirty_slots.push_back(index);
+    }
+}
@@ -1,6 +1,6 @@
 #include "shader.h"
 
-Shader::Shader(std::string vertex_path, std::string fragment_path) {
+Shader::Shader(std::string vertex_path, std::string fragment_path, const std::vector<std::string>& defines) {
     std::ifstream vertex_file(vertex_path);
     std::ifstream fragment_file(fragment_path);
 
@@ -30,8 +30,8 @@ Shader::Shader(std::string vertex_path, std::string fragment_path) {
     vertex_file.close();
     fragment_file.close();
 
-    std::string vertex_code = vertex_stream.str();
-    std::string fragment_code = fragment_stream.str();
+    std::string vertex_code = add_defines(vertex_stream.str(), defines);
+    std::string fragment_code = add_defines(fragment_stream.str(), defines);
 
     GLuint vertex_shader = compile(vertex_code, Shader::Type::Vertex);
     GLuint fragment_shader = compile(fragment_code, Shader::Type::Fragment);
@@ -41,6 +41,24 @@ Shader::Shader(std::string vertex_path, std::string fragment_path) {
     glDeleteShader(fragment_shader);
 }
 
+std::string Shader::add_defines(const std::string& source, const std::vector<std::string>& defines) {
+    if (defines.empty()) {
+        return source;
+    }
+
+    std::string define_lines;
+    for (const std::string& define : defines) {
+        define_lines += "#define " + define + "\n";
+    }
+
+    // #version must remain the first directive, so insert after its line
+    size_t version = source.find("#version");
+    size_t insert_pos = version == std::string::npos ? 0 : source.find('\n', version);
+    insert_pos = insert_pos == std::string::npos ? source.size() : insert_pos + 1;
+
+    return source.substr(0, insert_pos) + define_lines + source.substr(insert_pos);
+}
+
 GLuint Shader::compile(const std::string& source, Shader::Type type) {
     GLuint shader = glCreateShader(type);
     const char* source_ptr = source.c_str();
@@ -74,4 +92,52 @@ void Shader::link(GLuint vertex, GLuint fragment) {
         std::cerr << "Error linking shader: " << log << std::endl;
         std::terminate();
     }
+
+    reflect_uniforms();
+    bind_uniform_blocks();
+}
+
+void Shader::reflect_uniforms() {
+    GLint n_uniforms = 0;
+    GLint max_length = 0;
+    glGetProgramiv(this->id, GL_ACTIVE_UNIFORMS, &n_uniforms);
+    glGetProgramiv(this->id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+    std::vector<GLchar> buffer(max_length);
+    this->uniforms.clear();
+    this->uniforms.reserve(n_uniforms);
+
+    for (GLint i = 0; i < n_uniforms; i++) {
+        GLsizei length;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(this->id, i, max_length, &length, &size, &type, buffer.data());
+
+        std::string name(buffer.data(), length);
+        GLint location = glGetUniformLocation(this->id, name.c_str());
+        if (location < 0) {
+            continue; // members of uniform blocks have no location
+        }
+        this->uniforms[name] = location;
+
+        // arrays of basic types are reported once as "name[0]", so register every element as well
+        if (size > 1 && name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+            std::string base = name.substr(0, name.size() - 3);
+            this->uniforms[base] = location;
+
+            for (GLint j = 1; j < size; j++) {
+                std::string element = base + "[" + std::to_string(j) + "]";
+                this->uniforms[element] = glGetUniformLocation(this->id, element.c_str());
+            }
+        }
+    }
+}
+
+void Shader::bind_uniform_blocks() {
+    for (const auto& [name, binding] : uniform_block_bindings) {
+        GLuint index = glGetUniformBlockIndex(this->id, name);
+        if (index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(this->id, index, binding);
+        }
+    }
 }
@@ -1,12 +1,41 @@
 #include "texture.h"
+#include "threadpool.h"
+#include "meshcache.h"
+#include "cookedtexture.h"
+
+#include <filesystem>
+#include <cstring>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-Texture::Texture(const std::string& image_path) : unit(num_textures) {
+// S3TC is an extension, not part of the core profile headers
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// S3TC is not core, drivers without the extension reject the upload. Checked once, on the first cooked load
+static bool supports_s3tc() {
+    static const bool supported = []() {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) {
+                return true;
+            }
+        }
+        return false;
+    }();
+    return supported;
+}
+
+Texture::Texture(const std::string& image_path) {
     glGenTextures(1, &this->id);
-    glActiveTexture(GL_TEXTURE0 + num_textures++);
-    glBindTexture(GL_TEXTURE_2D, this->id);
+    GLState::bind_for_upload(GL_TEXTURE_2D, this->id);
     
     stbi_set_flip_vertically_on_load(true);
     unsigned char* data = stbi_load(image_path.c_str(), &this->width, &this->height, &this->n_channels, 0);
@@ -23,7 +52,8 @@ Texture::Texture(const std::string& image_path) : unit(num_textures) {
 
     if (data) {
         // generate a texture for the currently bound texture
-        glTexImage2D(GL_TEXTURE_2D, 0, format, this->width, this->height, 0, format, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, Texture::get_internal_format(format), this->width, this->height, 0, format,
+            GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
@@ -34,10 +64,9 @@ Texture::Texture(const std::string& image_path) : unit(num_textures) {
     stbi_image_free(data);
 }
 
-Texture::Texture(const ImageData& image_data) : unit(num_textures) {
+Texture::Texture(const ImageData& image_data) {
     glGenTextures(1, &this->id);
-    glActiveTexture(GL_TEXTURE0 + num_textures++);
-    glBindTexture(GL_TEXTURE_2D, this->id);
+    GLState::bind_for_upload(GL_TEXTURE_2D, this->id);
 
     this->width = image_data.width;
     this->height = image_data.height;
@@ -55,7 +84,8 @@ Texture::Texture(const ImageData& image_data) : unit(num_textures) {
 
     if (image_data.data) {
         // generate a texture for the currently bound texture
-        glTexImage2D(GL_TEXTURE_2D, 0, format, this->width, this->height, 0, format, GL_UNSIGNED_BYTE, image_data.data);
+        glTexImage2D(GL_TEXTURE_2D, 0, Texture::get_internal_format(format), this->width, this->height, 0, format,
+            GL_UNSIGNED_BYTE, image_data.data);
         glGenerateMipmap(GL_TEXTURE_2D);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
@@ -65,10 +95,9 @@ Texture::Texture(const ImageData& image_data) : unit(num_textures) {
     }
 }
 
-Texture::Texture(int width, int height) : unit(num_textures) {
+Texture::Texture(int width, int height) {
     glGenTextures(1, &this->id);
-    glActiveTexture(GL_TEXTURE0 + num_textures++);
-    glBindTexture(GL_TEXTURE_2D, this->id);
+    GLState::bind_for_upload(GL_TEXTURE_2D, this->id);
     
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
     
@@ -93,44 +122,173 @@ void Texture::set_type(Texture::Type type) {
     }
 }
 
-std::vector<Texture> Texture::load_textures(std::vector<std::string> image_paths) {
+GLenum Texture::get_internal_format(GLenum format) {
+    switch (format) {
+    case GL_RED:
+        return GL_R8;
+    case GL_RG:
+        return GL_RG8;
+    case GL_RGB:
+        return GL_RGB8;
+    case GL_RGBA: default:
+        return GL_RGBA8;
+    }
+}
+
+std::vector<Texture> Texture::load_textures(std::vector<std::string> image_paths, bool flip_vertically) {
     size_t length = image_paths.size();
-    std::vector<std::future<ImageData>> images(length);
-    stbi_set_flip_vertically_on_load(true);
 
-    // asynchronously read all images
+    // finished decodes in completion order. Shared with the jobs, which may still be inside notify after this
+    // function has taken their last image and returned
+    struct DecodedImage {
+        size_t index;
+        ImageData image;
+    };
+    struct DecodeState {
+        std::mutex mutex;
+        std::condition_variable decoded_ready;
+        std::vector<DecodedImage> decoded;
+    };
+    std::shared_ptr<DecodeState> state = std::make_shared<DecodeState>();
+
+    // the budget is reserved here rather than in the jobs, the shared workers also decode for the texture
+    // streamer and must never sit waiting for this thread to upload
+    std::vector<size_t> image_bytes(length, 0);
     for (size_t i = 0; i < length; i++) {
-        const std::string& image_path = image_paths[i];
+        int width, height, n_channels;
+        if (stbi_info(image_paths[i].c_str(), &width, &height, &n_channels)) {
+            image_bytes[i] = static_cast<size_t>(width) * height * n_channels;
+        }
+    }
 
-        images[i] = std::async(std::launch::async, [image_path](){
-            std::cout << "Loading " << image_path <<  std::endl;
-            ImageData image;
-            unsigned char* data = stbi_load(image_path.c_str(), &image.width, &image.height, &image.n_channels, 0);
-            image.data = data;
-            image.path = image_path;
+    std::vector<Texture> result(length);
+    size_t submitted = 0;
+    size_t reserved_bytes = 0;
 
-            return image;
-        });
-    }
+    for (size_t uploaded = 0; uploaded < length; uploaded++) {
+        // a single image larger than the whole budget is still let through once nothing else is reserved,
+        // otherwise it would never load
+        while (submitted < length
+               && (reserved_bytes == 0 || reserved_bytes + image_bytes[submitted] <= Texture::decode_budget)) {
+            reserved_bytes += image_bytes[submitted];
+            ThreadPool::shared().submit([state, i = submitted, image_path = image_paths[submitted], flip_vertically]() {
+                std::cout << "Loading " << image_path << std::endl;
 
-    std::vector<Texture> result;
+                // the flip flag is per thread, workers also run streaming jobs with their own setting
+                stbi_set_flip_vertically_on_load_thread(flip_vertically);
 
-    // wait for all images then create their textures
-    for (size_t i = 0; i < length; i++) {
-        ImageData image = images[i].get();
-        result.emplace_back(image);
-        stbi_image_free(image.data);
+                ImageData image;
+                image.path = image_path;
+                image.data = stbi_load(image_path.c_str(), &image.width, &image.height, &image.n_channels, 0);
+
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->decoded.push_back({i, image});
+                state->decoded_ready.notify_one();
+            });
+            submitted++;
+        }
+
+        // upload images as they finish, each upload frees budget for the next submissions
+        DecodedImage next;
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->decoded_ready.wait(lock, [&]() { return !state->decoded.empty(); });
+            next = state->decoded.back();
+            state->decoded.pop_back();
+        }
+
+        result[next.index] = Texture(next.image);
+        stbi_image_free(next.image.data);
+        reserved_bytes -= image_bytes[next.index];
     }
-    
+
     return result;
 }
 
-Texture Texture::load_cubemap(const std::vector<std::string>& faces, int texture_unit) {
+bool Texture::load_cooked(const std::string& image_path, bool flip_vertically, Texture& texture) {
+    std::string cooked_path = CookedTexture::get_cooked_path(image_path);
+
+    // a source edited after cooking wins over the cooked file
+    std::error_code error;
+    auto cooked_time = std::filesystem::last_write_time(cooked_path, error);
+    if (error) {
+        return false;
+    }
+    auto source_time = std::filesystem::last_write_time(image_path, error);
+    if (!error && source_time > cooked_time) {
+        return false;
+    }
+
+    MappedFile file(cooked_path);
+    if (!file.is_open() || file.size < sizeof(CookedTextureHeader)) {
+        return false;
+    }
+
+    CookedTextureHeader header;
+    std::memcpy(&header, file.data, sizeof(header));
+    uint64_t levels_size = uint64_t(header.level_count) * sizeof(CookedTextureLevel);
+    if (std::memcmp(header.magic, CookedTexture::magic, sizeof(header.magic)) != 0
+        || header.version != CookedTexture::version
+        || header.flipped != static_cast<uint32_t>(flip_vertically)
+        || header.level_count == 0
+        || levels_size > file.size - sizeof(CookedTextureHeader)) {
+        return false;
+    }
+
+    // without S3TC the caller decodes the source image instead, RGTC is core
+    GLenum format;
+    switch (header.format) {
+    case CookedFormat::BC1:
+        if (!supports_s3tc()) {
+            return false;
+        }
+        format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; break;
+    case CookedFormat::BC3:
+        if (!supports_s3tc()) {
+            return false;
+        }
+        format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+    case CookedFormat::BC4:
+        format = GL_COMPRESSED_RED_RGTC1; break;
+    case CookedFormat::BC5:
+        format = GL_COMPRESSED_RG_RGTC2; break;
+    default:
+        return false;
+    }
+
+    std::vector<CookedTextureLevel> levels(header.level_count);
+    std::memcpy(levels.data(), file.data + sizeof(CookedTextureHeader), levels_size);
+    for (const CookedTextureLevel& level : levels) {
+        if (level.offset > file.size || level.size > file.size - level.offset
+            || level.size != CookedTexture::get_level_size(header.format, level.width, level.height)) {
+            return false;
+        }
+    }
+
+    texture = Texture{};
+    glGenTextures(1, &texture.id);
+    GLState::bind_for_upload(GL_TEXTURE_2D, texture.id);
+
+    // every level is stored, nothing is decoded or generated here
+    for (size_t i = 0; i < levels.size(); i++) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, i, format, levels[i].width, levels[i].height, 0, levels[i].size,
+            file.data + levels[i].offset);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.level_count - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, header.channels == 4 ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, header.channels == 4 ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+
+    texture.width = header.width;
+    texture.height = header.height;
+    texture.n_channels = header.channels;
+    texture.path = image_path;
+    return true;
+}
+
+Texture Texture::load_cubemap(const std::vector<std::string>& faces) {
     Texture texture{};
     glGenTextures(1, &texture.id);
-    glActiveTexture(GL_TEXTURE0 + texture_unit);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, texture.id);
-    texture.unit = texture_unit;
+    GLState::bind_for_upload(GL_TEXTURE_CUBE_MAP, texture.id);
 
 #ifdef DEBUG
     if (faces.size() != 6) {
@@ -0,0 +1,107 @@
+#include "texturecache.h"
+
+#include <filesystem>
+#include <unordered_set>
+
+Texture TextureCache::load(const std::string& image_path, bool flip_vertically, TextureStreamer* streamer) {
+    return TextureCache::load(std::vector<std::string>{image_path}, flip_vertically, streamer)[0];
+}
+
+std::vector<Texture> TextureCache::load(const std::vector<std::string>& image_paths, bool flip_vertically,
+    TextureStreamer* streamer) {
+    std::vector<Texture> result(image_paths.size());
+    std::vector<std::string> keys(image_paths.size());
+    std::vector<bool> found(image_paths.size());
+
+    // collect the misses, a path repeated within the batch is only loaded once
+    std::vector<std::string> missing_paths, missing_keys;
+    std::unordered_set<std::string> seen_keys;
+    for (size_t i = 0; i < image_paths.size(); i++) {
+        keys[i] = TextureCache::make_key(image_paths[i], flip_vertically);
+        found[i] = TextureCache::find(keys[i], result[i]);
+
+        if (!found[i] && seen_keys.insert(keys[i]).second) {
+            missing_paths.push_back(image_paths[i]);
+            missing_keys.push_back(keys[i]);
+        }
+    }
+
+    if (missing_paths.empty()) {
+        return result;
+    }
+
+    // cooked textures upload as is, only the rest is decoded or streamed. The loaded textures hold their
+    // storage until the misses below have been resolved
+    std::vector<Texture> loaded(missing_paths.size());
+    std::vector<std::string> decode_paths;
+    std::vector<size_t> decode_slots;
+    for (size_t i = 0; i < missing_paths.size(); i++) {
+        if (Texture::load_cooked(missing_paths[i], flip_vertically, loaded[i])) {
+            loaded[i].storage = std::make_shared<TextureStorage>(loaded[i].id);
+        } else {
+            decode_paths.push_back(missing_paths[i]);
+            decode_slots.push_back(i);
+        }
+    }
+
+    if (streamer) {
+        for (size_t i = 0; i < decode_paths.size(); i++) {
+            loaded[decode_slots[i]] = streamer->request(decode_paths[i], flip_vertically);
+        }
+    } else {
+        std::vector<Texture> decoded = Texture::load_textures(decode_paths, flip_vertically);
+        for (size_t i = 0; i < decoded.size(); i++) {
+            decoded[i].storage = std::make_shared<TextureStorage>(decoded[i].id);
+            loaded[decode_slots[i]] = std::move(decoded[i]);
+        }
+    }
+
+    for (size_t i = 0; i < loaded.size(); i++) {
+        Entry& entry = TextureCache::entries[missing_keys[i]];
+        entry.texture = loaded[i];
+        entry.texture.storage.reset();
+        entry.storage = loaded[i].storage;
+    }
+
+    for (size_t i = 0; i < image_paths.size(); i++) {
+        if (!found[i]) {
+            TextureCache::find(keys[i], result[i]);
+        }
+    }
+    return result;
+}
+
+size_t TextureCache::get_texture_count() {
+    size_t count = 0;
+    for (const auto& [key, entry] : TextureCache::entries) {
+        count += !entry.storage.expired();
+    }
+    return count;
+}
+
+std::string TextureCache::make_key(const std::string& image_path, bool flip_vertically) {
+    // different spellings of the same file ("a/../b.png", "./b.png") share one entry
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::weakly_canonical(image_path, error);
+    std::string key = error ? image_path : path.string();
+    key += flip_vertically ? "|flip" : "|noflip";
+    return key;
+}
+
+bool TextureCache::find(const std::string& key, Texture& texture) {
+    auto it = TextureCache::entries.find(key);
+    if (it == TextureCache::entries.end()) {
+        return false;
+    }
+
+    std::shared_ptr<TextureStorage> storage = it->second.storage.lock();
+    if (!storage) {
+        // the last reference is gone and the GL texture with it
+        TextureCache::entries.erase(it);
+        return false;
+    }
+
+    texture = it->second.texture;
+    texture.storage = std::move(storage);
+    return true;
+}
@@ -0,0 +1,256 @@
+#include "texturestreamer.h"
+#include "threadpool.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+
+TextureStreamer::TextureStreamer(size_t upload_budget)
+    : upload_budget(upload_budget), queue(std::make_shared<DecodeQueue>()) {
+    glGenBuffers(1, &this->buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffer);
+
+    GLsizeiptr size = this->upload_budget * segment_count;
+    if (GLAD_GL_VERSION_4_4) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+        this->mapping = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+    } else {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureStreamer::~TextureStreamer() {
+    {
+        // decodes still running free their own image from now on
+        std::lock_guard<std::mutex> lock(this->queue->mutex);
+        this->queue->closed = true;
+        for (DecodedImage& decoded : this->queue->images) {
+            stbi_image_free(decoded.image.data);
+        }
+        this->queue->images.clear();
+    }
+
+    for (Upload& upload : this->uploads) {
+        stbi_image_free(upload.decoded.image.data);
+    }
+
+    for (GLsync fence : this->fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+
+    if (this->mapping) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &this->buffer);
+}
+
+Texture TextureStreamer::request(const std::string& image_path, bool flip_vertically) {
+    Texture texture{};
+    glGenTextures(1, &texture.id);
+    GLState::bind_for_upload(GL_TEXTURE_2D, texture.id);
+
+    // level 0 is defined later by the upload, until then only the placeholder level is sampled
+    const unsigned char placeholder[4] = {128, 128, 128, 255};
+    glTexImage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1);
+
+    texture.width = 1;
+    texture.height = 1;
+    texture.n_channels = 4;
+    texture.path = image_path;
+    texture.storage = std::make_shared<TextureStorage>(texture.id);
+
+    std::shared_ptr<DecodeQueue> queue = this->queue;
+    std::weak_ptr<TextureStorage> storage = texture.storage;
+    this->pending_count++;
+
+    ThreadPool::shared().submit([queue, storage, image_path, flip_vertically]() {
+        // set before anything else, the worker keeps whatever flag its previous job left
+        stbi_set_flip_vertically_on_load_thread(flip_vertically);
+
+        DecodedImage decoded = {storage, {}};
+        decoded.image.path = image_path;
+
+        // nothing to do if the texture was released while queued
+        if (!storage.expired()) {
+            decoded.image.data = stbi_load(image_path.c_str(), &decoded.image.width, &decoded.image.height,
+                &decoded.image.n_channels, 0);
+        }
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (queue->closed) {
+            stbi_image_free(decoded.image.data);
+            return;
+        }
+        queue->images.push_back(decoded);
+    });
+
+    return texture;
+}
+
+void TextureStreamer::update() {
+    this->uploaded_bytes = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(this->queue->mutex);
+        for (DecodedImage& decoded : this->queue->images) {
+            if (decoded.storage.expired()) {
+                stbi_image_free(decoded.image.data);
+                this->pending_count--;
+                continue;
+            }
+            if (!decoded.image.data) {
+                std::cerr << "Failed to load image " << decoded.image.path << std::endl;
+                std::terminate();
+            }
+
+            Upload upload;
+            upload.decoded = decoded;
+            switch (decoded.image.n_channels) {
+            case 1:
+                upload.format = GL_RED; break;
+            case 3:
+                upload.format = GL_RGB; break;
+            case 4: default:
+                upload.format = GL_RGBA; break;
+            }
+            upload.row_bytes = static_cast<size_t>(decoded.image.width) * decoded.image.n_channels;
+            this->uploads.push_back(upload);
+        }
+        this->queue->images.clear();
+    }
+
+    if (this->uploads.empty()) {
+        return;
+    }
+
+    // the GPU is still reading this segment, try again next frame rather than stall
+    GLsync& fence = this->fences[this->segment];
+    if (fence) {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            return;
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    // rows to copy this frame, recorded first because the fallback path has to unmap before copying
+    struct Band {
+        GLuint id;
+        GLenum format;
+        int width, height;
+        int first_row, row_count;
+        size_t offset;
+    };
+    std::vector<Band> bands;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffer);
+    size_t segment_offset = this->segment * this->upload_budget;
+    unsigned char* destination = this->mapping
+        ? this->mapping + segment_offset
+        : static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, segment_offset, this->upload_budget,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+
+    size_t used = 0;
+    for (Upload& upload : this->uploads) {
+        const ImageData& image = upload.decoded.image;
+        std::shared_ptr<TextureStorage> storage = upload.decoded.storage.lock();
+        if (!storage) {
+            // released mid-upload, its remaining rows are dropped
+            upload.next_row = image.height;
+            continue;
+        }
+
+        size_t row_count = std::min<size_t>(image.height - upload.next_row, (this->upload_budget - used) / upload.row_bytes);
+        if (row_count == 0) {
+            break;
+        }
+
+        size_t bytes = row_count * upload.row_bytes;
+        std::memcpy(destination + used, image.data + upload.next_row * upload.row_bytes, bytes);
+        bands.push_back({storage->id, upload.format, image.width, image.height,
+            upload.next_row, static_cast<int>(row_count), segment_offset + used});
+
+        upload.next_row += row_count;
+        used += bytes;
+        if (upload.next_row < image.height) {
+            break;
+        }
+    }
+
+    if (!this->mapping) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    // decoded rows are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (const Band& band : bands) {
+        GLState::bind_for_upload(GL_TEXTURE_2D, band.id);
+        if (band.first_row == 0) {
+            glTexImage2D(GL_TEXTURE_2D, 0, Texture::get_internal_format(band.format), band.width, band.height, 0,
+                band.format, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, band.first_row, band.width, band.row_count, band.format,
+            GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(band.offset));
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!bands.empty()) {
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        this->segment = (this->segment + 1) % segment_count;
+        this->uploaded_bytes = used;
+    }
+
+    // uploads are processed in order, so finished ones are all at the front
+    while (!this->uploads.empty() && this->uploads.front().next_row == this->uploads.front().decoded.image.height) {
+        this->finish(this->uploads.front());
+        stbi_image_free(this->uploads.front().decoded.image.data);
+        this->uploads.pop_front();
+        this->pending_count--;
+    }
+
+    // a row wider than a whole segment can never go through the ring, upload it directly
+    if (!this->uploads.empty() && this->uploads.front().row_bytes > this->upload_budget) {
+        Upload& upload = this->uploads.front();
+        std::shared_ptr<TextureStorage> storage = upload.decoded.storage.lock();
+        if (storage) {
+            const ImageData& image = upload.decoded.image;
+            GLState::bind_for_upload(GL_TEXTURE_2D, storage->id);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, Texture::get_internal_format(upload.format), image.width, image.height, 0,
+                upload.format, GL_UNSIGNED_BYTE, image.data);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            upload.next_row = image.height;
+            this->finish(upload);
+        }
+        stbi_image_free(upload.decoded.image.data);
+        this->uploads.pop_front();
+        this->pending_count--;
+    }
+}
+
+void TextureStreamer::finish(const Upload& upload) {
+    std::shared_ptr<TextureStorage> storage = upload.decoded.storage.lock();
+    if (!storage) {
+        return;
+    }
+
+    // level 0 is complete, replace the placeholder with the full mip chain
+    GLState::bind_for_upload(GL_TEXTURE_2D, storage->id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, upload.format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, upload.format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    this->finished_count++;
+}
@@ -0,0 +1,190 @@
+#include "vertexformat.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+VertexFormat VertexFormat::resolve(const Vertex* vertices, size_t count) const {
+    VertexFormat format = *this;
+    if (format.tex_coords != TexCoordEncoding::Unorm16) {
+        return format;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const glm::vec2& tex_coords = vertices[i].tex_coords;
+        if (tex_coords.x < 0.0f || tex_coords.x > 1.0f || tex_coords.y < 0.0f || tex_coords.y > 1.0f) {
+            format.tex_coords = TexCoordEncoding::Half;
+            break;
+        }
+    }
+    return format;
+}
+
+std::vector<std::string> VertexFormat::get_defines() const {
+    std::vector<std::string> defines;
+    if (this->quantize_positions) {
+        defines.push_back("QUANTIZED_POSITIONS");
+    }
+    if (this->pack_normals) {
+        defines.push_back("PACKED_NORMALS");
+    }
+    return defines;
+}
+
+std::vector<uint8_t> VertexFormat::pack(const Vertex* vertices, size_t count, const BoundingBox& bounds) const {
+    GLsizei stride = this->get_stride();
+    GLsizei normal_offset = this->get_normal_offset();
+    GLsizei tex_coords_offset = this->get_tex_coords_offset();
+
+    // flat axes, e.g. of a plane, map every position to 0
+    glm::vec3 size = bounds.max - bounds.min;
+    glm::vec3 scale = glm::vec3(
+        size.x > 0.0f ? 1.0f / size.x : 0.0f,
+        size.y > 0.0f ? 1.0f / size.y : 0.0f,
+        size.z > 0.0f ? 1.0f / size.z : 0.0f
+    );
+
+    std::vector<uint8_t> result(count * stride);
+    for (size_t i = 0; i < count; i++) {
+        const Vertex& vertex = vertices[i];
+        uint8_t* out = result.data() + i * stride;
+
+        if (this->quantize_positions) {
+            glm::vec3 normalized = glm::clamp((vertex.position - bounds.min) * scale, 0.0f, 1.0f);
+            uint16_t position[4] = {};
+            for (int c = 0; c < 3; c++) {
+                position[c] = static_cast<uint16_t>(std::lround(normalized[c] * 65535.0f));
+            }
+            std::memcpy(out, position, sizeof(position));
+        } else {
+            std::memcpy(out, &vertex.position, sizeof(glm::vec3));
+        }
+
+        if (this->pack_normals) {
+            glm::vec2 encoded = encode_octahedral(vertex.normal);
+            uint32_t normal = glm::packSnorm3x10_1x2(glm::vec4(encoded, 0.0f, 0.0f));
+            std::memcpy(out + normal_offset, &normal, sizeof(normal));
+        } else {
+            std::memcpy(out + normal_offset, &vertex.normal, sizeof(glm::vec3));
+        }
+
+        uint32_t tex_coords;
+        switch (this->tex_coords) {
+        case TexCoordEncoding::Float:
+            std::memcpy(out + tex_coords_offset, &vertex.tex_coords, sizeof(glm::vec2));
+            break;
+        case TexCoordEncoding::Half:
+            tex_coords = glm::packHalf2x16(vertex.tex_coords);
+            std::memcpy(out + tex_coords_offset, &tex_coords, sizeof(tex_coords));
+            break;
+        case TexCoordEncoding::Unorm16:
+            tex_coords = glm::packUnorm2x16(vertex.tex_coords);
+            std::memcpy(out + tex_coords_offset, &tex_coords, sizeof(tex_coords));
+            break;
+        }
+    }
+
+    return result;
+}
+
+Vertex VertexFormat::unpack(const uint8_t* packed_vertex, const BoundingBox& bounds) const {
+    Vertex vertex;
+
+    if (this->quantize_positions) {
+        uint16_t position[4];
+        std::memcpy(position, packed_vertex, sizeof(position));
+        glm::vec3 normalized = glm::vec3(position[0], position[1], position[2]) / 65535.0f;
+        vertex.position = bounds.min + normalized * (bounds.max - bounds.min);
+    } else {
+        std::memcpy(&vertex.position, packed_vertex, sizeof(glm::vec3));
+    }
+
+    if (this->pack_normals) {
+        uint32_t normal;
+        std::memcpy(&normal, packed_vertex + this->get_normal_offset(), sizeof(normal));
+        vertex.normal = decode_octahedral(glm::vec2(glm::unpackSnorm3x10_1x2(normal)));
+    } else {
+        std::memcpy(&vertex.normal, packed_vertex + this->get_normal_offset(), sizeof(glm::vec3));
+    }
+
+    uint32_t tex_coords;
+    switch (this->tex_coords) {
+    case TexCoordEncoding::Float:
+        std::memcpy(&vertex.tex_coords, packed_vertex + this->get_tex_coords_offset(), sizeof(glm::vec2));
+        break;
+    case TexCoordEncoding::Half:
+        std::memcpy(&tex_coords, packed_vertex + this->get_tex_coords_offset(), sizeof(tex_coords));
+        vertex.tex_coords = glm::unpackHalf2x16(tex_coords);
+        break;
+    case TexCoordEncoding::Unorm16:
+        std::memcpy(&tex_coords, packed_vertex + this->get_tex_coords_offset(), sizeof(tex_coords));
+        vertex.tex_coords = glm::unpackUnorm2x16(tex_coords);
+        break;
+    }
+
+    return vertex;
+}
+
+void VertexFormat::setup_attributes() const {
+    GLsizei stride = this->get_stride();
+
+    // vertex positions
+    if (this->quantize_positions) {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)0);
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    }
+    glEnableVertexAttribArray(0);
+
+    // vertex normals, packed ones only use x and y
+    void* normal_offset = (void*)(size_t)this->get_normal_offset();
+    if (this->pack_normals) {
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, normal_offset);
+    } else {
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, normal_offset);
+    }
+    glEnableVertexAttribArray(1);
+
+    // texture coordinates
+    void* tex_coords_offset = (void*)(size_t)this->get_tex_coords_offset();
+    switch (this->tex_coords) {
+    case TexCoordEncoding::Float:
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, tex_coords_offset);
+        break;
+    case TexCoordEncoding::Half:
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, tex_coords_offset);
+        break;
+    case TexCoordEncoding::Unorm16:
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, tex_coords_offset);
+        break;
+    }
+    glEnableVertexAttribArray(2);
+}
+
+glm::vec2 VertexFormat::encode_octahedral(const glm::vec3& normal) {
+    float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if (length == 0.0f) {
+        return glm::vec2(0.0f); // degenerate normals come back as +z
+    }
+
+    glm::vec3 n = normal / length;
+    if (n.z >= 0.0f) {
+        return glm::vec2(n);
+    }
+
+    // fold the lower hemisphere over the diagonals
+    return glm::vec2(
+        (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+        (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f)
+    );
+}
+
+glm::vec3 VertexFormat::decode_octahedral(const glm::vec2& encoded) {
+    glm::vec3 n = glm::vec3(encoded, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+    float fold = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -fold : fold;
+    n.y += n.y >= 0.0f ? -fold : fold;
+    return glm::normalize(n);
+}
@@ -1,12 +1,49 @@
 #include "window.h"
 
-Window::Window(int width, int height, std::string title) : width(width), height(height), title(title) {
+#ifdef HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+Window::Window(int width, int height, std::string title, bool headless)
+    : width(width), height(height), title(title), headless(headless), start_time(std::chrono::steady_clock::now()) {
+    if (headless) {
+        this->create_headless_context();
+    } else {
+        this->create_window();
+    }
+
+    glViewport(0, 0, width, height);
+
+#ifdef DEBUG
+    glEnable(GL_DEBUG_OUTPUT);
+    std::cout << "[OpenGL] Version: " << glGetString(GL_VERSION) << std::endl;
+    glDebugMessageCallback(error_message_callback, nullptr);
+#endif
+
+    this->state.last_x = width / 2;
+    this->state.last_y = height / 2;
+};
+
+Window::~Window() {
+#ifdef HAS_EGL
+    if (this->headless) {
+        eglMakeCurrent(this->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(this->egl_display, this->egl_context);
+        eglTerminate(this->egl_display);
+        return;
+    }
+#endif
+    glfwTerminate();
+}
+
+void Window::create_window() {
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    GLFWwindow* window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+    GLFWwindow* window = glfwCreateWindow(this->width, this->height, this->title.c_str(), nullptr, nullptr);
     if (!window) {
         std::cerr << "Failed to create GLFW window." << std::endl;
         glfwTerminate();
@@ -20,24 +57,81 @@ Window::Window(int width, int height, std::string title) : width(width), height(
         std::terminate();
     }
 
-    glViewport(0, 0, width, height);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
-#ifdef DEBUG
-    glEnable(GL_DEBUG_OUTPUT);
-    std::cout << "[OpenGL] Version: " << glGetString(GL_VERSION) << std::endl;
-    glDebugMessageCallback(error_message_callback, nullptr);
-#endif
-
     glfwSetInputMode(window, GLFW_STICKY_KEYS, GLFW_TRUE);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
 
     this->ptr = window;
-    this->state.last_x = width / 2;
-    this->state.last_y = height / 2;
-};
+}
+
+void Window::create_headless_context() {
+#ifdef HAS_EGL
+    // the surfaceless platform needs neither a display server nor a GPU device, other drivers may only offer
+    // the default display
+    EGLDisplay display = EGL_NO_DISPLAY;
+    auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display) {
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        std::cerr << "Failed to initialize EGL." << std::endl;
+        std::terminate();
+    }
+
+    // configs default to window surfaces, which a surfaceless display has none of
+    const EGLint config_attributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint config_count = 0;
+    EGLContext context = EGL_NO_CONTEXT;
+    if (eglBindAPI(EGL_OPENGL_API) && eglChooseConfig(display, config_attributes, &config, 1, &config_count)
+        && config_count > 0) {
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+    }
+    // current without a surface, everything is drawn into framebuffer objects
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cerr << "Failed to create EGL context (error 0x" << std::hex << eglGetError() << std::dec << ")."
+                  << std::endl;
+        eglTerminate(display);
+        std::terminate();
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        std::cerr << "Failed to initialize GLAD." << std::endl;
+        std::terminate();
+    }
+
+    this->egl_display = display;
+    this->egl_context = context;
+#else
+    std::cerr << "Headless mode needs EGL, which was not found when building." << std::endl;
+    std::terminate();
+#endif
+}
+
+double Window::get_time() const {
+    if (this->headless) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - this->start_time).count();
+    }
+    return glfwGetTime();
+}
 
 void Window::framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     Window* win_ptr = static_cast<Window*>(glfwGetWindowUserPointer(window));
@@ -71,6 +165,20 @@ void Window::process_input() {
     if (glfwGetKey(this->ptr, GLFW_KEY_E) == GLFW_RELEASE && !this->state.e_key_released) {
         this->state.e_key_released = true;
     }
+    // Pick the entity under the cursor, or under the crosshair while the camera is being controlled
+    if (glfwGetMouseButton(this->ptr, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && this->state.mouse_left_released) {
+        this->state.mouse_left_released = false;
+        this->state.pick_requested = true;
+        if (this->state.show_debug) {
+            glfwGetCursorPos(this->ptr, &this->state.pick_x, &this->state.pick_y);
+        } else {
+            this->state.pick_x = this->width / 2.0;
+            this->state.pick_y = this->height / 2.0;
+        }
+    }
+    if (glfwGetMouseButton(this->ptr, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE && !this->state.mouse_left_released) {
+        this->state.mouse_left_released = true;
+    }
     // Change texture mix
     if (glfwGetKey(this->ptr, GLFW_KEY_UP) == GLFW_PRESS) {
         this->state.mix = std::min(this->state.mix + 0.02f, 1.0f);
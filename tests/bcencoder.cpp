@@ -0,0 +1,80 @@
+// Compresses a grey and alpha image the way texture-cooker does and decodes it again, checking both channels
+// survive BC5 and come back where a GL_COMPRESSED_RG_RGTC2 texture samples them.
+
+#include "bcencoder.h"
+#include "check.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+// the eight value mode of a BC4 block, which is the only one the encoder writes
+static void decode_channel_block(const uint8_t* block, uint8_t* values) {
+    int palette[8] = {block[0], block[1]};
+    for (int k = 2; k < 8; k++) {
+        palette[k] = ((8 - k) * block[0] + (k - 1) * block[1]) / 7;
+    }
+
+    uint64_t packed = 0;
+    for (int i = 0; i < 6; i++) {
+        packed |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+    }
+    for (int i = 0; i < 16; i++) {
+        values[i] = palette[(packed >> (i * 3)) & 7];
+    }
+}
+
+int main() {
+    // not a multiple of the block size, so the edge blocks are covered too
+    const uint32_t width = 13, height = 10;
+
+    // grey rises left to right and alpha top to bottom, stbi_load with 4 channels expands them to (g, g, g, a)
+    std::vector<uint8_t> grey(width * height), alpha(width * height), pixels(width * height * 4);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            uint32_t i = y * width + x;
+            grey[i] = static_cast<uint8_t>(x * 255 / (width - 1));
+            alpha[i] = static_cast<uint8_t>(255 - y * 255 / (height - 1));
+            pixels[i * 4 + 0] = pixels[i * 4 + 1] = pixels[i * 4 + 2] = grey[i];
+            pixels[i * 4 + 3] = alpha[i];
+        }
+    }
+
+    std::vector<uint8_t> compressed = BCEncoder::compress(pixels.data(), width, height, CookedFormat::BC5);
+    uint32_t blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+    CHECK(compressed.size() == CookedTexture::get_level_size(CookedFormat::BC5, width, height));
+    if (compressed.size() != blocks_x * blocks_y * 16) {
+        return 1;
+    }
+
+    int max_red_error = 0, max_green_error = 0;
+    for (uint32_t by = 0; by < blocks_y; by++) {
+        for (uint32_t bx = 0; bx < blocks_x; bx++) {
+            const uint8_t* block = compressed.data() + (by * blocks_x + bx) * 16;
+            uint8_t red[16], green[16];
+            decode_channel_block(block, red);
+            decode_channel_block(block + 8, green);
+
+            for (uint32_t y = 0; y < 4; y++) {
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t source_x = std::min(bx * 4 + x, width - 1);
+                    uint32_t source_y = std::min(by * 4 + y, height - 1);
+                    uint32_t i = source_y * width + source_x;
+                    max_red_error = std::max(max_red_error, std::abs(red[y * 4 + x] - grey[i]));
+                    max_green_error = std::max(max_green_error, std::abs(green[y * 4 + x] - alpha[i]));
+                }
+            }
+        }
+    }
+
+    // a block spans at most 85 values of either gradient, so palette entries are 12 apart and nothing is off by more
+    // than half of that plus rounding
+    std::printf("bc5 grey and alpha: max error %d red, %d green\n", max_red_error, max_green_error);
+    CHECK(max_red_error <= 8);
+    CHECK(max_green_error <= 8);
+
+    if (check_failures == 0) {
+        std::printf("bcencoder: all checks passed\n");
+    }
+    return check_failures != 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdio>
+
+// Each test is a plain executable run by ctest, failing checks are printed and make main return non-zero.
+
+inline int check_failures = 0;
+
+#define CHECK(condition)                                                                             \
+    do {                                                                                             \
+        if (!(condition)) {                                                                          \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);      \
+            check_failures++;                                                                        \
+        }                                                                                            \
+    } while (0)
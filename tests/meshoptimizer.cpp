@@ -0,0 +1,151 @@
+// Runs each MeshOptimizer pass on a sphere with its triangles shuffled, checking the passes only reorder
+// what is drawn and never leave the vertex cache worse off than they found it.
+
+#include "meshoptimizer.h"
+#include "check.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <tuple>
+
+using Triangle = std::array<GLuint, 3>;
+
+// latitude-longitude sphere, triangles in random order like a mesh exported without care for the cache
+static MeshData make_shuffled_sphere(uint32_t segments) {
+    MeshData mesh;
+    for (uint32_t y = 0; y <= segments; y++) {
+        for (uint32_t x = 0; x <= segments; x++) {
+            float theta = glm::pi<float>() * y / segments;
+            float phi = glm::two_pi<float>() * x / segments;
+            glm::vec3 position(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            mesh.vertices.push_back({position, position, glm::vec2(float(x) / segments, float(y) / segments)});
+        }
+    }
+
+    std::vector<Triangle> triangles;
+    for (uint32_t y = 0; y < segments; y++) {
+        for (uint32_t x = 0; x < segments; x++) {
+            GLuint a = y * (segments + 1) + x, b = a + 1, c = a + segments + 1, d = c + 1;
+            triangles.push_back({a, c, b});
+            triangles.push_back({b, c, d});
+        }
+    }
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(1));
+    for (const Triangle& triangle : triangles) {
+        mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+    }
+    return mesh;
+}
+
+// the triangles as a sorted list, each rotated to start at its smallest index so winding is kept
+static std::vector<Triangle> get_triangles(const std::vector<GLuint>& indices) {
+    std::vector<Triangle> triangles;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        Triangle triangle = {indices[i], indices[i + 1], indices[i + 2]};
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+// the same, as the vertices they reference, for passes that renumber vertices
+static std::vector<std::array<float, 9>> get_triangle_positions(const MeshData& mesh) {
+    std::vector<std::array<float, 9>> triangles;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        std::array<glm::vec3, 3> corners;
+        for (int c = 0; c < 3; c++) {
+            corners[c] = mesh.vertices[mesh.indices[i + c]].position;
+        }
+        auto less = [](const glm::vec3& a, const glm::vec3& b) {
+            return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+        };
+        std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end(), less), corners.end());
+
+        std::array<float, 9> triangle;
+        for (int c = 0; c < 3; c++) {
+            triangle[c * 3] = corners[c].x;
+            triangle[c * 3 + 1] = corners[c].y;
+            triangle[c * 3 + 2] = corners[c].z;
+        }
+        triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+int main() {
+    for (uint32_t segments : {4, 32, 128}) {
+        MeshData mesh = make_shuffled_sphere(segments);
+        const std::vector<Triangle> triangles = get_triangles(mesh.indices);
+        const auto positions = get_triangle_positions(mesh);
+        size_t vertex_count = mesh.vertices.size();
+        VertexCacheStats shuffled = MeshOptimizer::analyze_vertex_cache(mesh.indices, vertex_count);
+
+        std::vector<GLuint> indices = mesh.indices;
+        MeshOptimizer::optimize_vertex_cache(indices, vertex_count);
+        VertexCacheStats cache = MeshOptimizer::analyze_vertex_cache(indices, vertex_count);
+        CHECK(get_triangles(indices) == triangles);
+        CHECK(cache.acmr <= shuffled.acmr);
+        CHECK(cache.atvr >= 1.0f);
+        if (segments >= 32) {
+            CHECK(cache.acmr < 0.8f); // a shuffled sphere starts out near 2.5
+        }
+
+        // overdraw may give up ACMR, but only within its threshold
+        MeshOptimizer::optimize_overdraw(indices, mesh.vertices, 1.05f);
+        VertexCacheStats overdraw = MeshOptimizer::analyze_vertex_cache(indices, vertex_count);
+        CHECK(get_triangles(indices) == triangles);
+        CHECK(overdraw.acmr <= cache.acmr * 1.05f);
+        CHECK(overdraw.acmr <= shuffled.acmr);
+
+        // renumbering keeps the cache behaviour and orders vertices by first use
+        MeshData fetched = mesh;
+        fetched.indices = indices;
+        MeshOptimizer::optimize_vertex_fetch(fetched.vertices, fetched.indices);
+        VertexCacheStats fetch = MeshOptimizer::analyze_vertex_cache(fetched.indices, fetched.vertices.size());
+        CHECK(fetched.vertices.size() == vertex_count);
+        CHECK(fetch.acmr == overdraw.acmr);
+        CHECK(get_triangle_positions(fetched) == positions);
+        GLuint next = 0;
+        for (GLuint index : fetched.indices) {
+            CHECK(index <= next);
+            next = std::max(next, index + 1);
+        }
+
+        // all passes together, from the shuffled mesh
+        MeshData optimized = mesh;
+        MeshOptimizer::optimize(optimized, MeshOptimizer::VertexCache | MeshOptimizer::Overdraw
+                                           | MeshOptimizer::VertexFetch);
+        CHECK(get_triangle_positions(optimized) == positions);
+        CHECK(MeshOptimizer::analyze_vertex_cache(optimized.indices, optimized.vertices.size()).acmr
+              <= shuffled.acmr);
+    }
+
+    // unreferenced vertices are dropped, the referenced ones keep their data
+    MeshData sparse = make_shuffled_sphere(4);
+    sparse.vertices.insert(sparse.vertices.begin(), Vertex{glm::vec3(9.0f), glm::vec3(0, 1, 0), glm::vec2(0.0f)});
+    for (GLuint& index : sparse.indices) {
+        index++;
+    }
+    const auto sparse_positions = get_triangle_positions(sparse);
+    size_t referenced = sparse.vertices.size() - 1;
+    MeshOptimizer::optimize_vertex_fetch(sparse.vertices, sparse.indices);
+    CHECK(sparse.vertices.size() == referenced);
+    CHECK(get_triangle_positions(sparse) == sparse_positions);
+
+    // empty meshes pass through
+    std::vector<GLuint> empty;
+    MeshOptimizer::optimize_vertex_cache(empty, 0);
+    CHECK(empty.empty());
+    CHECK(MeshOptimizer::analyze_vertex_cache(empty, 0).acmr == 0.0f);
+
+    if (check_failures == 0) {
+        std::printf("meshoptimizer: all checks passed\n");
+    }
+    return check_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// Builds levels of detail through MeshOptimizer::optimize with the flags a model import uses, checking the
+// level ranges, that each level has fewer triangles and more error than the one before, and that the error
+// a level reports matches how far the full detail surface is from it.
+
+#include "mesh.h"
+#include "meshoptimizer.h"
+#include "check.h"
+
+#include <algorithm>
+#include <cmath>
+
+// distance from p to the triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+static float distance_to_triangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return glm::length(p - a);
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return glm::length(p - b);
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return glm::length(p - c);
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+    }
+
+    float denominator = 1.0f / (va + vb + vc);
+    return glm::length(p - (a + ab * (vb * denominator) + ac * (vc * denominator)));
+}
+
+// indexed grid over [-1, 1] in xz, sharing vertices so only its border is locked
+template <typename Height>
+static MeshData make_grid(uint32_t segments, Height height) {
+    MeshData mesh;
+    for (uint32_t z = 0; z <= segments; z++) {
+        for (uint32_t x = 0; x <= segments; x++) {
+            glm::vec2 uv(float(x) / segments, float(z) / segments);
+            glm::vec3 position(uv.x * 2.0f - 1.0f, 0.0f, uv.y * 2.0f - 1.0f);
+            position.y = height(position.x, position.z);
+            mesh.vertices.push_back({position, glm::vec3(0.0f, 1.0f, 0.0f), uv});
+        }
+    }
+    for (uint32_t z = 0; z < segments; z++) {
+        for (uint32_t x = 0; x < segments; x++) {
+            GLuint a = z * (segments + 1) + x, b = a + 1, c = a + segments + 1, d = c + 1;
+            mesh.indices.insert(mesh.indices.end(), {a, c, b, b, c, d});
+        }
+    }
+    return mesh;
+}
+
+// returns the number of levels after checking them
+static size_t check_lods(MeshData mesh) {
+    size_t triangle_count = mesh.indices.size() / 3;
+    MeshOptimizer::optimize(mesh, MeshOptimizer::All);
+
+    CHECK(!mesh.lods.empty());
+    if (mesh.lods.empty()) {
+        return 0;
+    }
+    CHECK(mesh.lods[0].first_index == 0);
+    CHECK(mesh.lods[0].index_count / 3 == triangle_count);
+    CHECK(mesh.lods[0].error == 0.0f);
+
+    // levels are back to back, each coarser than the one before
+    for (size_t lod = 1; lod < mesh.lods.size(); lod++) {
+        const MeshLod& previous = mesh.lods[lod - 1];
+        const MeshLod& level = mesh.lods[lod];
+        CHECK(level.first_index == previous.first_index + previous.index_count);
+        CHECK(level.index_count % 3 == 0 && level.index_count > 0);
+        CHECK(level.index_count < previous.index_count);
+        CHECK(level.error >= previous.error);
+    }
+    const MeshLod& last = mesh.lods.back();
+    CHECK(last.first_index + last.index_count == mesh.indices.size());
+    for (GLuint index : mesh.indices) {
+        CHECK(index < mesh.vertices.size());
+    }
+
+    // the quadric error measures how far the kept vertices moved off the input planes, the other direction
+    // measured here can come out a little larger, so it is only held to the error up to a margin
+    for (size_t lod = 1; lod < mesh.lods.size(); lod++) {
+        const MeshLod& level = mesh.lods[lod];
+        float largest = 0.0f;
+        for (const Vertex& vertex : mesh.vertices) {
+            float nearest = INFINITY;
+            for (uint32_t i = level.first_index; i < level.first_index + level.index_count; i += 3) {
+                nearest = std::min(nearest, distance_to_triangle(vertex.position,
+                                                                 mesh.vertices[mesh.indices[i]].position,
+                                                                 mesh.vertices[mesh.indices[i + 1]].position,
+                                                                 mesh.vertices[mesh.indices[i + 2]].position));
+            }
+            largest = std::max(largest, nearest);
+        }
+        CHECK(largest <= level.error * 1.5f + 1e-4f);
+    }
+    return mesh.lods.size();
+}
+
+int main() {
+    // every corner of the generated cube and plane is a seam or border, so nothing collapses
+    MeshData cube = Mesh::generate_cube_mesh();
+    CHECK(check_lods(cube) == 1);
+    MeshData plane = Mesh::generate_plane_mesh();
+    CHECK(check_lods(plane) == 1);
+
+    // a flat grid loses its interior at no error
+    MeshData flat = make_grid(32, [](float, float) { return 0.0f; });
+    CHECK(check_lods(flat) > 1);
+    MeshOptimizer::optimize(flat, MeshOptimizer::All);
+    CHECK(flat.lods.back().error < 1e-4f);
+    CHECK(flat.lods.back().index_count < flat.lods[0].index_count / 4);
+
+    // rolling hills cost error as they flatten
+    MeshData hills = make_grid(48, [](float x, float z) { return 0.1f * std::sin(x * 4.0f) * std::cos(z * 3.0f); });
+    CHECK(check_lods(hills) > 2);
+    MeshOptimizer::optimize(hills, MeshOptimizer::All);
+    CHECK(hills.lods.back().error > 0.0f);
+
+    if (check_failures == 0) {
+        std::printf("meshsimplifier: all checks passed\n");
+    }
+    return check_failures == 0 ? 0 : 1;
+}
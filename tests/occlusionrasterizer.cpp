@@ -0,0 +1,223 @@
+// Checks OcclusionRasterizer against occluders built from generated meshes. Built twice by CMake, once with
+// AVX2 and once without, so both the 8-wide and the scalar paths are covered. Besides a few scenes with known
+// answers, the depth buffer is compared with ray casts through every pixel center and is_visible with a
+// plain loop over get_depth.
+
+#include "occlusionrasterizer.h"
+#include "check.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+static BoundingBox make_box(const glm::vec3& center, const glm::vec3& half_size) {
+    return {center - half_size, center + half_size};
+}
+
+struct Occluder {
+    const MeshData* mesh;
+    glm::mat4 world;
+};
+
+// nearest window depth along the ray through each pixel center, 1 where nothing is hit
+static std::vector<float> ray_cast_depth(const std::vector<Occluder>& occluders, const glm::mat4& view_projection,
+                                         int width, int height) {
+    std::vector<glm::vec3> triangles;
+    for (const Occluder& occluder : occluders) {
+        for (GLuint index : occluder.mesh->indices) {
+            triangles.push_back(glm::vec3(occluder.world * glm::vec4(occluder.mesh->vertices[index].position, 1.0f)));
+        }
+    }
+
+    glm::mat4 inverse = glm::inverse(view_projection);
+    std::vector<float> depth(width * height, 1.0f);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            glm::vec2 ndc = glm::vec2((x + 0.5f) / width, (y + 0.5f) / height) * 2.0f - glm::vec2(1.0f);
+            glm::vec4 near = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+            glm::vec4 far = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+            glm::vec3 origin = glm::vec3(near) / near.w;
+            glm::vec3 direction = glm::vec3(far) / far.w - origin;
+
+            // Moller-Trumbore, two-sided
+            float nearest = INFINITY;
+            for (size_t i = 0; i < triangles.size(); i += 3) {
+                glm::vec3 edge1 = triangles[i + 1] - triangles[i];
+                glm::vec3 edge2 = triangles[i + 2] - triangles[i];
+                glm::vec3 p = glm::cross(direction, edge2);
+                float determinant = glm::dot(edge1, p);
+                if (std::fabs(determinant) < 1e-12f) {
+                    continue;
+                }
+                glm::vec3 s = origin - triangles[i];
+                float u = glm::dot(s, p) / determinant;
+                glm::vec3 q = glm::cross(s, edge1);
+                float v = glm::dot(direction, q) / determinant;
+                float t = glm::dot(edge2, q) / determinant;
+                if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t <= 1.0f) {
+                    nearest = std::min(nearest, t);
+                }
+            }
+            if (nearest != INFINITY) {
+                glm::vec4 clip = view_projection * glm::vec4(origin + direction * nearest, 1.0f);
+                depth[y * width + x] = clip.z / clip.w * 0.5f + 0.5f;
+            }
+        }
+    }
+    return depth;
+}
+
+// the box test without SIMD, from the rasterized depth
+static bool is_visible_reference(const OcclusionRasterizer& rasterizer, const glm::mat4& view_projection,
+                                 const BoundingBox& box) {
+    int width = rasterizer.get_width(), height = rasterizer.get_height();
+    glm::vec2 min_screen = glm::vec2(width, height);
+    glm::vec2 max_screen = glm::vec2(0.0f);
+    float min_depth = 1.0f;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner = glm::vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y,
+                                     i & 4 ? box.max.z : box.min.z);
+        glm::vec4 clip = view_projection * glm::vec4(corner, 1.0f);
+        if (clip.w <= 0.0f) {
+            return true;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        glm::vec2 screen = (glm::vec2(ndc) * 0.5f + 0.5f) * glm::vec2(width, height);
+        min_screen = glm::min(min_screen, screen);
+        max_screen = glm::max(max_screen, screen);
+        min_depth = std::min(min_depth, ndc.z * 0.5f + 0.5f);
+    }
+
+    int min_x = std::max(0, static_cast<int>(std::floor(min_screen.x)));
+    int min_y = std::max(0, static_cast<int>(std::floor(min_screen.y)));
+    int max_x = std::min(width - 1, static_cast<int>(std::floor(max_screen.x)));
+    int max_y = std::min(height - 1, static_cast<int>(std::floor(max_screen.y)));
+    for (int y = min_y; y <= max_y; y++) {
+        for (int x = min_x; x <= max_x; x++) {
+            if (rasterizer.get_depth(x, y) >= min_depth) {
+                return true;
+            }
+        }
+    }
+    return min_x > max_x || min_y > max_y;
+}
+
+int main() {
+#if defined(__AVX2__)
+    // ctest counts this as skipped, see SKIP_RETURN_CODE in CMakeLists.txt
+    if (!__builtin_cpu_supports("avx2")) {
+        std::printf("occlusionrasterizer: no AVX2 on this CPU, skipped\n");
+        return 77;
+    }
+    const char* path = "AVX2";
+#else
+    const char* path = "scalar";
+#endif
+
+    MeshData cube = Mesh::generate_cube_mesh();
+    MeshData plane = Mesh::generate_plane_mesh();
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 view_projection = projection * view;
+    OcclusionRasterizer rasterizer;
+
+    // a 4x4 wall at z = 0, facing the camera
+    rasterizer.begin(view_projection);
+    glm::mat4 wall = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    rasterizer.add_occluder(plane, glm::scale(wall, glm::vec3(4.0f)));
+    rasterizer.rasterize();
+    CHECK(!rasterizer.is_visible(make_box({0.0f, 0.0f, -3.0f}, glm::vec3(0.5f))));  // behind
+    CHECK(rasterizer.is_visible(make_box({0.0f, 0.0f, 2.0f}, glm::vec3(0.5f))));    // in front
+    CHECK(rasterizer.is_visible(make_box({5.0f, 0.0f, -3.0f}, glm::vec3(0.5f))));   // beside
+    CHECK(rasterizer.is_visible(make_box({2.2f, 0.0f, -1.0f}, glm::vec3(0.5f))));   // across the edge
+    CHECK(rasterizer.is_visible(make_box({0.0f, 0.0f, 0.0f}, glm::vec3(0.5f))));    // through the wall
+    CHECK(rasterizer.is_visible(make_box({0.0f, 0.0f, 5.0f}, glm::vec3(1.0f))));    // around the camera
+
+    // a cube scaled by 2 hides small boxes behind it but not wider ones
+    rasterizer.begin(view_projection);
+    rasterizer.add_occluder(cube, glm::scale(glm::mat4(1.0f), glm::vec3(2.0f)));
+    rasterizer.rasterize();
+    CHECK(!rasterizer.is_visible(make_box({0.0f, 0.0f, -3.0f}, glm::vec3(0.4f))));
+    CHECK(rasterizer.is_visible(make_box({0.0f, 0.0f, -3.0f}, {3.0f, 3.0f, 0.4f})));
+
+    // a floor reaching behind the camera is clipped at the near plane
+    glm::mat4 floor_view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    rasterizer.begin(projection * floor_view);
+    glm::mat4 floor = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+    rasterizer.add_occluder(plane, glm::scale(floor, glm::vec3(200.0f, 1.0f, 200.0f)));
+    rasterizer.rasterize();
+    CHECK(rasterizer.get_triangle_count() > 2);
+    CHECK(!rasterizer.is_visible(make_box({0.0f, -3.0f, -10.0f}, glm::vec3(1.0f))));
+    CHECK(rasterizer.is_visible(make_box({0.0f, 1.0f, -10.0f}, glm::vec3(1.0f))));
+    CHECK(rasterizer.is_visible(make_box({0.0f, -1.5f, -10.0f}, glm::vec3(1.0f)))); // half below the floor
+
+    // nothing drawn hides nothing
+    rasterizer.begin(view_projection);
+    rasterizer.rasterize();
+    CHECK(rasterizer.is_visible(make_box({0.0f, 0.0f, -3.0f}, glm::vec3(0.1f))));
+
+    // random cubes and planes in front of the camera. Pixel centers within rounding of an edge may go
+    // either way, everywhere else the depth has to match the ray casts
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<Occluder> occluders;
+    for (int i = 0; i < 24; i++) {
+        glm::mat4 world = glm::translate(glm::mat4(1.0f), glm::vec3(unit(rng) * 3.0f, unit(rng) * 1.5f,
+                                                                    unit(rng) * 2.0f - 1.0f));
+        glm::vec3 axis = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.01f));
+        world = glm::rotate(world, unit(rng) * 3.0f, axis);
+        world = glm::scale(world, glm::vec3(0.5f + 0.4f * unit(rng)));
+        occluders.push_back({i % 2 ? &cube : &plane, world});
+    }
+
+    // 16:9 leaves padding rows below the last tile row, a 4:3 window gives 320x240 which has none
+    int mismatches = 0, pixel_count = 0;
+    for (int height : {180, 240}) {
+        int width = 320;
+        rasterizer.resize(width, height);
+        glm::mat4 size_projection = glm::perspective(glm::radians(60.0f), float(width) / height, 0.1f, 100.0f);
+        glm::mat4 size_view_projection = size_projection * view;
+
+        rasterizer.begin(size_view_projection);
+        for (const Occluder& occluder : occluders) {
+            rasterizer.add_occluder(*occluder.mesh, occluder.world);
+        }
+        rasterizer.rasterize();
+
+        std::vector<float> expected = ray_cast_depth(occluders, size_view_projection, width, height);
+        int size_mismatches = 0;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                size_mismatches += std::fabs(rasterizer.get_depth(x, y) - expected[y * width + x]) > 1e-4f;
+            }
+        }
+        CHECK(size_mismatches <= width * height / 200);
+        mismatches += size_mismatches;
+        pixel_count += width * height;
+
+        // the SIMD box test agrees with the plain one on every box
+        int visible = 0;
+        for (int i = 0; i < 20000; i++) {
+            glm::vec3 center(unit(rng) * 4.0f, unit(rng) * 2.0f, unit(rng) * 4.0f - 4.0f);
+            BoundingBox box = make_box(center, glm::vec3(0.05f + 0.3f * (unit(rng) + 1.0f)));
+            bool is_visible = rasterizer.is_visible(box);
+            CHECK(is_visible == is_visible_reference(rasterizer, size_view_projection, box));
+            visible += is_visible;
+        }
+        CHECK(visible > 0 && visible < 20000);
+
+        // smaller than a pixel on the top row near the right edge, so the test reads only the end of the buffer
+        // and starts at an x that is not a multiple of 8
+        glm::vec4 corner = glm::inverse(size_view_projection) * glm::vec4(1.0f - 2.0f * 3.5f / width, 1.0f, 0.9f, 1.0f);
+        BoundingBox corner_box = make_box(glm::vec3(corner) / corner.w, glm::vec3(0.001f));
+        CHECK(rasterizer.is_visible(corner_box) == is_visible_reference(rasterizer, size_view_projection, corner_box));
+    }
+
+    if (check_failures == 0) {
+        std::printf("occlusionrasterizer (%s): all checks passed, %d of %d pixels off the ray casts\n", path,
+                    mismatches, pixel_count);
+    }
+    return check_failures == 0 ? 0 : 1;
+}
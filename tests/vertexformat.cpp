@@ -0,0 +1,121 @@
+// Packs vertices in every VertexFormat and unpacks them again, checking each attribute comes back within
+// the precision of its encoding.
+
+#include "vertexformat.h"
+#include "check.h"
+
+#include <random>
+#include <cmath>
+
+static std::vector<Vertex> make_vertices(size_t count, const BoundingBox& bounds) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> gaussian;
+
+    std::vector<Vertex> vertices(count);
+    for (Vertex& vertex : vertices) {
+        vertex.position = bounds.min + glm::vec3(unit(rng), unit(rng), unit(rng)) * (bounds.max - bounds.min);
+        vertex.normal = glm::normalize(glm::vec3(gaussian(rng), gaussian(rng), gaussian(rng)));
+        vertex.tex_coords = glm::vec2(unit(rng), unit(rng));
+    }
+
+    // the corners of the octahedral square and the hemisphere seam
+    const glm::vec3 axes[] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    for (size_t i = 0; i < 6; i++) {
+        vertices[i].normal = axes[i];
+    }
+    vertices[6].normal = glm::normalize(glm::vec3(1.0f, -1.0f, 0.0f));
+    vertices[7].normal = glm::normalize(glm::vec3(-1.0f, 1.0f, -1.0f));
+    vertices[8].tex_coords = glm::vec2(0.0f, 1.0f);
+    return vertices;
+}
+
+static void check_round_trip(const VertexFormat& format, const std::vector<Vertex>& vertices,
+                             const BoundingBox& bounds) {
+    std::vector<uint8_t> packed = format.pack(vertices.data(), vertices.size(), bounds);
+    CHECK(packed.size() == vertices.size() * format.get_stride());
+
+    // half a quantization step, a step of a flat axis is 0
+    glm::vec3 position_error = (bounds.max - bounds.min) * (0.5f / 65535.0f) + 1e-6f;
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex& expected = vertices[i];
+        Vertex vertex = format.unpack(packed.data() + i * format.get_stride(), bounds);
+
+        if (format.quantize_positions) {
+            glm::vec3 error = glm::abs(vertex.position - expected.position);
+            CHECK(error.x <= position_error.x && error.y <= position_error.y && error.z <= position_error.z);
+        } else {
+            CHECK(vertex.position == expected.position);
+        }
+
+        // 10-bit snorm components put the decoded normal within about half a degree
+        if (format.pack_normals) {
+            CHECK(std::fabs(glm::length(vertex.normal) - 1.0f) < 1e-5f);
+            CHECK(glm::dot(vertex.normal, expected.normal) > 0.99995f);
+        } else {
+            CHECK(vertex.normal == expected.normal);
+        }
+
+        glm::vec2 error = glm::abs(vertex.tex_coords - expected.tex_coords);
+        switch (format.tex_coords) {
+        case TexCoordEncoding::Float:
+            CHECK(vertex.tex_coords == expected.tex_coords);
+            break;
+        case TexCoordEncoding::Half:
+            CHECK(error.x <= 0.5f / 2048.0f && error.y <= 0.5f / 2048.0f); // 11 significant bits below 1
+            break;
+        case TexCoordEncoding::Unorm16:
+            CHECK(error.x <= 0.5f / 65535.0f + 1e-7f && error.y <= 0.5f / 65535.0f + 1e-7f);
+            break;
+        }
+    }
+}
+
+int main() {
+    // documented sizes of the two presets
+    CHECK(VertexFormat().get_stride() == sizeof(Vertex));
+    CHECK(VertexFormat::packed().get_stride() == 20);
+    CHECK(VertexFormat::quantized().get_stride() == 16);
+
+    BoundingBox bounds = {glm::vec3(-3.0f, -0.5f, 2.0f), glm::vec3(5.0f, 0.5f, 10.0f)};
+    std::vector<Vertex> vertices = make_vertices(1000, bounds);
+    for (bool quantize_positions : {false, true}) {
+        for (bool pack_normals : {false, true}) {
+            for (TexCoordEncoding tex_coords : {TexCoordEncoding::Float, TexCoordEncoding::Half,
+                                                TexCoordEncoding::Unorm16}) {
+                check_round_trip({quantize_positions, pack_normals, tex_coords}, vertices, bounds);
+            }
+        }
+    }
+
+    // a plane is flat along y, every packed y is 0 and comes back as the plane's height
+    BoundingBox flat_bounds = {glm::vec3(-1.0f, 0.25f, -1.0f), glm::vec3(1.0f, 0.25f, 1.0f)};
+    std::vector<Vertex> flat = make_vertices(100, flat_bounds);
+    check_round_trip(VertexFormat::quantized(), flat, flat_bounds);
+    std::vector<uint8_t> packed = VertexFormat::quantized().pack(flat.data(), flat.size(), flat_bounds);
+    for (size_t i = 0; i < flat.size(); i++) {
+        CHECK(VertexFormat::quantized().unpack(packed.data() + i * 16, flat_bounds).position.y == 0.25f);
+    }
+
+    // degenerate normals decode as +z
+    CHECK(VertexFormat::decode_octahedral(VertexFormat::encode_octahedral(glm::vec3(0.0f))) == glm::vec3(0, 0, 1));
+
+    // Unorm16 only holds [0, 1], tiled coordinates fall back to Half, other encodings are kept as is
+    VertexFormat unorm = {true, true, TexCoordEncoding::Unorm16};
+    CHECK(unorm.resolve(vertices.data(), vertices.size()) == unorm);
+    std::vector<Vertex> tiled = vertices;
+    tiled.back().tex_coords = glm::vec2(2.0f, 0.5f);
+    VertexFormat resolved = unorm.resolve(tiled.data(), tiled.size());
+    CHECK(resolved.tex_coords == TexCoordEncoding::Half);
+    CHECK(resolved.quantize_positions && resolved.pack_normals);
+    tiled.back().tex_coords = glm::vec2(0.5f, -0.01f);
+    CHECK(unorm.resolve(tiled.data(), tiled.size()).tex_coords == TexCoordEncoding::Half);
+    CHECK(VertexFormat::quantized().resolve(tiled.data(), tiled.size()) == VertexFormat::quantized());
+    check_round_trip(resolved, tiled, bounds);
+
+    if (check_failures == 0) {
+        std::printf("vertexformat: all checks passed\n");
+    }
+    return check_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,323 @@
+#include "bcencoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+uint16_t pack_565(const float* color) {
+    int r = std::clamp(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+    int g = std::clamp(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+    int b = std::clamp(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+// expands to 8 bits per channel the way the hardware does
+void unpack_565(uint16_t color, float* result) {
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    result[0] = static_cast<float>((r << 3) | (r >> 2));
+    result[1] = static_cast<float>((g << 2) | (g >> 4));
+    result[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+// the block's pixels split into one array per channel
+struct ColorBlock {
+    alignas(16) float r[16];
+    alignas(16) float g[16];
+    alignas(16) float b[16];
+};
+
+// maps every pixel to the closest of the four palette colors, returns the summed squared error
+float select_indices(const ColorBlock& pixels, const float palette[4][3], uint8_t* indices) {
+#if defined(__SSE2__)
+    __m128 total = _mm_setzero_ps();
+
+    // four pixels against one palette color per step
+    for (int i = 0; i < 16; i += 4) {
+        __m128 r = _mm_load_ps(pixels.r + i);
+        __m128 g = _mm_load_ps(pixels.g + i);
+        __m128 b = _mm_load_ps(pixels.b + i);
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i best_index = _mm_setzero_si128();
+
+        for (int c = 0; c < 4; c++) {
+            __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[c][0]));
+            __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[c][1]));
+            __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[c][2]));
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+            best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(c)), _mm_andnot_si128(closer, best_index));
+            best = _mm_min_ps(distance, best);
+        }
+
+        alignas(16) int32_t lane_indices[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lane_indices), best_index);
+        for (int j = 0; j < 4; j++) {
+            indices[i + j] = static_cast<uint8_t>(lane_indices[j]);
+        }
+        total = _mm_add_ps(total, best);
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+    float total = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float best = FLT_MAX;
+        for (int c = 0; c < 4; c++) {
+            float dr = pixels.r[i] - palette[c][0];
+            float dg = pixels.g[i] - palette[c][1];
+            float db = pixels.b[i] - palette[c][2];
+            float distance = dr * dr + dg * dg + db * db;
+            if (distance < best) {
+                best = distance;
+                indices[i] = c;
+            }
+        }
+        total += best;
+    }
+    return total;
+#endif
+}
+
+// quantizes the endpoints and selects indices against the palette the decoder will actually see
+float evaluate_endpoints(const ColorBlock& pixels, const float* start, const float* end,
+    uint16_t& color0, uint16_t& color1, uint8_t* indices) {
+    color0 = pack_565(start);
+    color1 = pack_565(end);
+
+    float palette[4][3];
+    unpack_565(color0, palette[0]);
+    unpack_565(color1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+    return select_indices(pixels, palette, indices);
+}
+
+} // namespace
+
+void BCEncoder::encode_color_block(const uint8_t* pixels, uint8_t* block) {
+    ColorBlock colors;
+    float mean[3] = {};
+    for (int i = 0; i < 16; i++) {
+        colors.r[i] = pixels[i * 4 + 0];
+        colors.g[i] = pixels[i * 4 + 1];
+        colors.b[i] = pixels[i * 4 + 2];
+        mean[0] += colors.r[i];
+        mean[1] += colors.g[i];
+        mean[2] += colors.b[i];
+    }
+    for (float& channel : mean) {
+        channel /= 16.0f;
+    }
+
+    // principal axis of the block's colors, found by power iteration on the covariance matrix
+    float covariance[3][3] = {};
+    for (int i = 0; i < 16; i++) {
+        float d[3] = {colors.r[i] - mean[0], colors.g[i] - mean[1], colors.b[i] - mean[2]};
+        for (int a = 0; a < 3; a++) {
+            for (int b = 0; b < 3; b++) {
+                covariance[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3];
+        for (int a = 0; a < 3; a++) {
+            next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+        }
+        float length = std::max({std::fabs(next[0]), std::fabs(next[1]), std::fabs(next[2])});
+        if (length < 1e-6f) {
+            break; // flat block, any axis works
+        }
+        for (int a = 0; a < 3; a++) {
+            axis[a] = next[a] / length;
+        }
+    }
+    float axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for (float& component : axis) {
+        component /= axis_length;
+    }
+
+    // endpoints at the extremes of the projection, pulled in slightly since the extremes are rarely hit
+    float min_t = FLT_MAX, max_t = -FLT_MAX;
+    for (int i = 0; i < 16; i++) {
+        float t = (colors.r[i] - mean[0]) * axis[0] + (colors.g[i] - mean[1]) * axis[1] + (colors.b[i] - mean[2]) * axis[2];
+        min_t = std::min(min_t, t);
+        max_t = std::max(max_t, t);
+    }
+    float inset = (max_t - min_t) / 16.0f;
+    min_t += inset;
+    max_t -= inset;
+
+    float start[3], end[3];
+    for (int c = 0; c < 3; c++) {
+        start[c] = std::clamp(mean[c] + axis[c] * max_t, 0.0f, 255.0f);
+        end[c] = std::clamp(mean[c] + axis[c] * min_t, 0.0f, 255.0f);
+    }
+
+    uint16_t color0, color1;
+    uint8_t indices[16];
+    float error = evaluate_endpoints(colors, start, end, color0, color1, indices);
+
+    // refine both endpoints with a least squares fit to the chosen indices
+    constexpr float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[3] = {}, bx[3] = {};
+    for (int i = 0; i < 16; i++) {
+        float a = weights[indices[i]];
+        float b = 1.0f - a;
+        float pixel[3] = {colors.r[i], colors.g[i], colors.b[i]};
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < 3; c++) {
+            ax[c] += a * pixel[c];
+            bx[c] += b * pixel[c];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) > 1e-6f) {
+        float refined_start[3], refined_end[3];
+        for (int c = 0; c < 3; c++) {
+            refined_start[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+            refined_end[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+        }
+
+        uint16_t refined0, refined1;
+        uint8_t refined_indices[16];
+        float refined_error = evaluate_endpoints(colors, refined_start, refined_end, refined0, refined1, refined_indices);
+        if (refined_error < error) {
+            color0 = refined0;
+            color1 = refined1;
+            std::memcpy(indices, refined_indices, sizeof(indices));
+        }
+    }
+
+    // the four color mode needs color0 > color1, swapping the endpoints swaps indices 0/1 and 2/3
+    if (color0 < color1) {
+        std::swap(color0, color1);
+        for (uint8_t& index : indices) {
+            index ^= 1;
+        }
+    } else if (color0 == color1) {
+        std::memset(indices, 0, sizeof(indices));
+    }
+
+    uint32_t packed = 0;
+    for (int i = 0; i < 16; i++) {
+        packed |= static_cast<uint32_t>(indices[i]) << (i * 2);
+    }
+
+    block[0] = color0 & 0xff;
+    block[1] = color0 >> 8;
+    block[2] = color1 & 0xff;
+    block[3] = color1 >> 8;
+    std::memcpy(block + 4, &packed, sizeof(packed));
+}
+
+void BCEncoder::encode_channel_block(const uint8_t* pixels, int channel, uint8_t* block) {
+    uint8_t values[16];
+    uint8_t min_value = 255, max_value = 0;
+    for (int i = 0; i < 16; i++) {
+        values[i] = pixels[i * 4 + channel];
+        min_value = std::min(min_value, values[i]);
+        max_value = std::max(max_value, values[i]);
+    }
+
+    // eight value mode (first endpoint greater), with six values interpolated between the endpoints
+    int palette[8] = {max_value, min_value};
+    for (int k = 2; k < 8; k++) {
+        palette[k] = ((8 - k) * max_value + (k - 1) * min_value) / 7;
+    }
+
+    uint64_t packed = 0;
+    if (max_value != min_value) {
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            for (int k = 1; k < 8; k++) {
+                if (std::abs(values[i] - palette[k]) < std::abs(values[i] - palette[best])) {
+                    best = k;
+                }
+            }
+            packed |= static_cast<uint64_t>(best) << (i * 3);
+        }
+    }
+
+    block[0] = max_value;
+    block[1] = min_value;
+    for (int i = 0; i < 6; i++) {
+        block[2 + i] = (packed >> (i * 8)) & 0xff;
+    }
+}
+
+void BCEncoder::encode_bc1(const uint8_t* pixels, uint8_t* block) {
+    BCEncoder::encode_color_block(pixels, block);
+}
+
+void BCEncoder::encode_bc3(const uint8_t* pixels, uint8_t* block) {
+    BCEncoder::encode_channel_block(pixels, 3, block);
+    BCEncoder::encode_color_block(pixels, block + 8);
+}
+
+void BCEncoder::encode_bc4(const uint8_t* pixels, uint8_t* block) {
+    BCEncoder::encode_channel_block(pixels, 0, block);
+}
+
+void BCEncoder::encode_bc5(const uint8_t* pixels, uint8_t* block) {
+    // a grey and alpha source expanded to RGBA is (g, g, g, a), its alpha is in channel 3 rather than 1
+    BCEncoder::encode_channel_block(pixels, 0, block);
+    BCEncoder::encode_channel_block(pixels, 3, block + 8);
+}
+
+std::vector<uint8_t> BCEncoder::compress(const uint8_t* pixels, uint32_t width, uint32_t height, CookedFormat format) {
+    uint32_t blocks_x = (width + 3) / 4;
+    uint32_t blocks_y = (height + 3) / 4;
+    uint32_t block_bytes = CookedTexture::get_block_bytes(format);
+    std::vector<uint8_t> result(static_cast<size_t>(blocks_x) * blocks_y * block_bytes);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int64_t by = 0; by < blocks_y; by++) {
+        uint8_t block_pixels[64];
+
+        for (uint32_t bx = 0; bx < blocks_x; bx++) {
+            // blocks hanging over the edge repeat the last row and column
+            for (uint32_t y = 0; y < 4; y++) {
+                uint32_t source_y = std::min<uint32_t>(by * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t source_x = std::min(bx * 4 + x, width - 1);
+                    std::memcpy(block_pixels + (y * 4 + x) * 4, pixels + (static_cast<size_t>(source_y) * width + source_x) * 4, 4);
+                }
+            }
+
+            uint8_t* block = result.data() + (static_cast<size_t>(by) * blocks_x + bx) * block_bytes;
+            switch (format) {
+            case CookedFormat::BC1:
+                BCEncoder::encode_bc1(block_pixels, block); break;
+            case CookedFormat::BC3:
+                BCEncoder::encode_bc3(block_pixels, block); break;
+            case CookedFormat::BC4:
+                BCEncoder::encode_bc4(block_pixels, block); break;
+            case CookedFormat::BC5:
+                BCEncoder::encode_bc5(block_pixels, block); break;
+            }
+        }
+    }
+
+    return result;
+}
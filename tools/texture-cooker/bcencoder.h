@@ -0,0 +1,25 @@
+#pragma once
+
+#include "cookedtexture.h"
+
+#include <vector>
+#include <cstdint>
+
+// Block compression encoders. Every block function takes the 16 pixels of a 4x4 block in row-major order
+// as RGBA8 and writes one compressed block.
+class BCEncoder {
+public:
+    static void encode_bc1(const uint8_t* pixels, uint8_t* block);
+    static void encode_bc3(const uint8_t* pixels, uint8_t* block);
+    static void encode_bc4(const uint8_t* pixels, uint8_t* block); // red channel
+    static void encode_bc5(const uint8_t* pixels, uint8_t* block); // red and alpha channels, as red and green
+
+    // compresses a whole RGBA8 image, rows of blocks are encoded in parallel
+    static std::vector<uint8_t> compress(const uint8_t* pixels, uint32_t width, uint32_t height, CookedFormat format);
+
+private:
+    // color endpoints and indices shared by BC1 and the color half of BC3
+    static void encode_color_block(const uint8_t* pixels, uint8_t* block);
+    // one 8-byte BC4 block from the given channel
+    static void encode_channel_block(const uint8_t* pixels, int channel, uint8_t* block);
+};
@@ -0,0 +1,165 @@
+#include "bcencoder.h"
+#include "cookedtexture.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Converts source images into block-compressed .ctex files with a full mip chain, written next to each
+// source so TextureCache picks them up instead of decoding the image at runtime.
+//
+// Usage: texture-cooker [--no-flip] <image>...
+
+// halves an RGBA8 image with a 2x2 box filter, odd edges reuse their last row or column
+static std::vector<uint8_t> downsample(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height) {
+    uint32_t next_width = std::max(width / 2, 1u);
+    uint32_t next_height = std::max(height / 2, 1u);
+    std::vector<uint8_t> result(static_cast<size_t>(next_width) * next_height * 4);
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t y = 0; y < next_height; y++) {
+        uint32_t y0 = std::min<uint32_t>(y * 2, height - 1);
+        uint32_t y1 = std::min<uint32_t>(y * 2 + 1, height - 1);
+
+        for (uint32_t x = 0; x < next_width; x++) {
+            uint32_t x0 = std::min(x * 2, width - 1);
+            uint32_t x1 = std::min(x * 2 + 1, width - 1);
+
+            for (int c = 0; c < 4; c++) {
+                uint32_t sum = pixels[(static_cast<size_t>(y0) * width + x0) * 4 + c]
+                    + pixels[(static_cast<size_t>(y0) * width + x1) * 4 + c]
+                    + pixels[(static_cast<size_t>(y1) * width + x0) * 4 + c]
+                    + pixels[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+                result[(static_cast<size_t>(y) * next_width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+            }
+        }
+    }
+
+    return result;
+}
+
+static CookedFormat choose_format(const std::vector<uint8_t>& pixels, int channels) {
+    switch (channels) {
+    case 1:
+        return CookedFormat::BC4;
+    case 2:
+        return CookedFormat::BC5;
+    case 3:
+        return CookedFormat::BC1;
+    default:
+        // images with an alpha channel that is fully opaque fit in half the space
+        for (size_t i = 3; i < pixels.size(); i += 4) {
+            if (pixels[i] != 255) {
+                return CookedFormat::BC3;
+            }
+        }
+        return CookedFormat::BC1;
+    }
+}
+
+static bool cook(const std::string& source_path, bool flip_vertically) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load(flip_vertically);
+    unsigned char* data = stbi_load(source_path.c_str(), &width, &height, &channels, 4);
+    if (!data) {
+        std::cerr << "Failed to load image " << source_path << std::endl;
+        return false;
+    }
+
+    // channels are expanded to RGBA so every format reads the same layout
+    std::vector<uint8_t> pixels(data, data + static_cast<size_t>(width) * height * 4);
+    stbi_image_free(data);
+
+    CookedTextureHeader header = {};
+    std::memcpy(header.magic, CookedTexture::magic, sizeof(header.magic));
+    header.version = CookedTexture::version;
+    header.format = choose_format(pixels, channels);
+    header.width = width;
+    header.height = height;
+    header.channels = channels;
+    header.flipped = flip_vertically;
+
+    std::vector<CookedTextureLevel> levels;
+    std::vector<std::vector<uint8_t>> level_data;
+    uint32_t level_width = width, level_height = height;
+
+    while (true) {
+        level_data.push_back(BCEncoder::compress(pixels.data(), level_width, level_height, header.format));
+        levels.push_back({0, level_data.back().size(), level_width, level_height});
+
+        if (level_width == 1 && level_height == 1) {
+            break;
+        }
+        pixels = downsample(pixels, level_width, level_height);
+        level_width = std::max(level_width / 2, 1u);
+        level_height = std::max(level_height / 2, 1u);
+    }
+    header.level_count = levels.size();
+
+    uint64_t offset = sizeof(CookedTextureHeader) + levels.size() * sizeof(CookedTextureLevel);
+    for (CookedTextureLevel& level : levels) {
+        level.offset = offset;
+        offset += level.size;
+    }
+
+    // written to a temporary file first so the engine never maps a partial file
+    std::string cooked_path = CookedTexture::get_cooked_path(source_path);
+    std::string temporary_path = cooked_path + ".tmp";
+    std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(CookedTextureLevel));
+    for (const std::vector<uint8_t>& data : level_data) {
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+    out.close();
+
+    std::error_code error;
+    if (out) {
+        std::filesystem::rename(temporary_path, cooked_path, error);
+    }
+    if (!out || error) {
+        std::cerr << "Failed to write " << cooked_path << std::endl;
+        std::filesystem::remove(temporary_path, error);
+        return false;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Cooked " << source_path << " (" << width << "x" << height << ", BC"
+        << static_cast<uint32_t>(header.format) << ", " << levels.size() << " levels, "
+        << offset / 1024 << " KB) in "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool flip_vertically = true;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--no-flip") == 0) {
+            flip_vertically = false;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (paths.empty()) {
+        std::cerr << "Usage: texture-cooker [--no-flip] <image>..." << std::endl;
+        return 1;
+    }
+
+    bool success = true;
+    for (const std::string& path : paths) {
+        success &= cook(path, flip_vertically);
+    }
+    return success ? 0 : 1;
+}